@@ -0,0 +1,339 @@
+#include <new>
+#include <string>
+#include <vector>
+#include <tuple>
+#include <stdexcept>
+
+#include "audioslicer.h"
+#include "realtime.h"
+#include "slicer.h"
+
+struct audioslicer {
+    Slicer slicer;
+    std::vector<audioslicer_chunk> result;
+};
+
+struct audioslicer_stream {
+    StreamSlicer stream;
+    std::vector<audioslicer_chunk> result;
+};
+
+struct audioslicer_realtime {
+    RealtimeSlicer slicer;
+    RealtimeClipReader reader;
+    std::vector<float> clip;
+
+    audioslicer_realtime(const Slicer& slicer, unsigned int channels, uint64_t max_block_frames, uint64_t buffer_frames)
+            : slicer(slicer, channels, max_block_frames, buffer_frames),
+              reader(this->slicer)
+    {}
+};
+
+static thread_local std::string last_error;
+
+static int fail(int status, const char *message)
+{
+    last_error = message;
+    return status;
+}
+
+// Runs f, turning exceptions into status codes, since none may cross the C boundary.
+template<class F>
+static int guarded(F f)
+{
+    try
+    {
+        f();
+        last_error.clear();
+        return AUDIOSLICER_OK;
+    }
+    catch (const std::invalid_argument& err)
+    {
+        return fail(AUDIOSLICER_ERROR_INVALID_ARGUMENT, err.what());
+    }
+    catch (const std::bad_alloc&)
+    {
+        return fail(AUDIOSLICER_ERROR_OUT_OF_MEMORY, "Out of memory");
+    }
+    catch (const std::exception& err)
+    {
+        return fail(AUDIOSLICER_ERROR_INTERNAL, err.what());
+    }
+    catch (...)
+    {
+        return fail(AUDIOSLICER_ERROR_INTERNAL, "Unknown error");
+    }
+}
+
+static void store_chunks(const std::vector<std::tuple<uint64_t, uint64_t>>& chunks, std::vector<audioslicer_chunk>& result,
+                         const audioslicer_chunk **out, size_t *count)
+{
+    result.clear();
+    result.reserve(chunks.size());
+    for (const auto& chunk : chunks)
+    {
+        result.push_back({std::get<0>(chunk), std::get<1>(chunk)});
+    }
+    *out = result.data();
+    *count = result.size();
+}
+
+unsigned int audioslicer_api_version(void)
+{
+    return AUDIOSLICER_API_VERSION;
+}
+
+const char *audioslicer_last_error(void)
+{
+    return last_error.c_str();
+}
+
+void audioslicer_default_params(audioslicer_params *params)
+{
+    if (!params)
+    {
+        return;
+    }
+    params->threshold_db = -40.0;
+    params->min_length_ms = 5000;
+    params->min_interval_ms = 300;
+    params->hop_size_ms = 10;
+    params->max_sil_kept_ms = 500;
+}
+
+int audioslicer_create(int sample_rate, const audioslicer_params *params, audioslicer **slicer)
+{
+    if (!params || !slicer)
+    {
+        return fail(AUDIOSLICER_ERROR_INVALID_ARGUMENT, "Null argument");
+    }
+    if (sample_rate <= 0)
+    {
+        return fail(AUDIOSLICER_ERROR_INVALID_ARGUMENT, "The sample rate must be positive");
+    }
+    *slicer = nullptr;
+    return guarded([&]()
+    {
+        *slicer = new audioslicer {Slicer(sample_rate, params->threshold_db, params->min_length_ms, params->min_interval_ms,
+                                          params->hop_size_ms, params->max_sil_kept_ms), {}};
+    });
+}
+
+void audioslicer_destroy(audioslicer *slicer)
+{
+    delete slicer;
+}
+
+int audioslicer_set_max_length(audioslicer *slicer, uint64_t max_length_ms)
+{
+    if (!slicer)
+    {
+        return fail(AUDIOSLICER_ERROR_INVALID_ARGUMENT, "Null argument");
+    }
+    return guarded([&]()
+    {
+        slicer->slicer.set_max_length(max_length_ms);
+    });
+}
+
+int audioslicer_set_channel_mode(audioslicer *slicer, int mode)
+{
+    if (!slicer)
+    {
+        return fail(AUDIOSLICER_ERROR_INVALID_ARGUMENT, "Null argument");
+    }
+    switch (mode)
+    {
+        case AUDIOSLICER_CHANNELS_MIX:
+            slicer->slicer.set_channel_mode(ChannelMode::Mix);
+            break;
+        case AUDIOSLICER_CHANNELS_MAX:
+            slicer->slicer.set_channel_mode(ChannelMode::Max);
+            break;
+        case AUDIOSLICER_CHANNELS_POWER:
+            slicer->slicer.set_channel_mode(ChannelMode::Power);
+            break;
+        default:
+            return fail(AUDIOSLICER_ERROR_INVALID_ARGUMENT, "Unknown channel mode");
+    }
+    return AUDIOSLICER_OK;
+}
+
+int audioslicer_set_single_precision(audioslicer *slicer, int single_precision)
+{
+    if (!slicer)
+    {
+        return fail(AUDIOSLICER_ERROR_INVALID_ARGUMENT, "Null argument");
+    }
+    slicer->slicer.set_single_precision(single_precision != 0);
+    return AUDIOSLICER_OK;
+}
+
+int audioslicer_slice(audioslicer *slicer, const float *samples, uint64_t frames, unsigned int channels,
+                      const audioslicer_chunk **chunks, size_t *count)
+{
+    if (!slicer || !chunks || !count || (!samples && frames > 0))
+    {
+        return fail(AUDIOSLICER_ERROR_INVALID_ARGUMENT, "Null argument");
+    }
+    if (channels == 0)
+    {
+        return fail(AUDIOSLICER_ERROR_INVALID_ARGUMENT, "The number of channels must be positive");
+    }
+    return guarded([&]()
+    {
+        auto result = slicer->slicer.slice(samples, frames * channels, channels);
+        store_chunks(result, slicer->result, chunks, count);
+    });
+}
+
+int audioslicer_slice_int16(audioslicer *slicer, const int16_t *samples, uint64_t frames, unsigned int channels,
+                            const audioslicer_chunk **chunks, size_t *count)
+{
+    if (!slicer || !chunks || !count || (!samples && frames > 0))
+    {
+        return fail(AUDIOSLICER_ERROR_INVALID_ARGUMENT, "Null argument");
+    }
+    if (channels == 0)
+    {
+        return fail(AUDIOSLICER_ERROR_INVALID_ARGUMENT, "The number of channels must be positive");
+    }
+    return guarded([&]()
+    {
+        auto result = slicer->slicer.slice(samples, frames * channels, channels);
+        store_chunks(result, slicer->result, chunks, count);
+    });
+}
+
+int audioslicer_stream_create(const audioslicer *slicer, audioslicer_stream **stream)
+{
+    if (!slicer || !stream)
+    {
+        return fail(AUDIOSLICER_ERROR_INVALID_ARGUMENT, "Null argument");
+    }
+    *stream = nullptr;
+    return guarded([&]()
+    {
+        *stream = new audioslicer_stream {StreamSlicer(slicer->slicer), {}};
+    });
+}
+
+void audioslicer_stream_destroy(audioslicer_stream *stream)
+{
+    delete stream;
+}
+
+int audioslicer_stream_feed(audioslicer_stream *stream, const float *samples, uint64_t frames, unsigned int channels,
+                            const audioslicer_chunk **chunks, size_t *count)
+{
+    if (!stream || !chunks || !count || (!samples && frames > 0))
+    {
+        return fail(AUDIOSLICER_ERROR_INVALID_ARGUMENT, "Null argument");
+    }
+    if (channels == 0)
+    {
+        return fail(AUDIOSLICER_ERROR_INVALID_ARGUMENT, "The number of channels must be positive");
+    }
+    return guarded([&]()
+    {
+        auto result = stream->stream.feed(samples, frames, channels);
+        store_chunks(result, stream->result, chunks, count);
+    });
+}
+
+int audioslicer_stream_finish(audioslicer_stream *stream, const audioslicer_chunk **chunks, size_t *count)
+{
+    if (!stream || !chunks || !count)
+    {
+        return fail(AUDIOSLICER_ERROR_INVALID_ARGUMENT, "Null argument");
+    }
+    return guarded([&]()
+    {
+        auto result = stream->stream.finish();
+        store_chunks(result, stream->result, chunks, count);
+    });
+}
+
+uint64_t audioslicer_stream_frames(const audioslicer_stream *stream)
+{
+    return stream ? stream->stream.frames() : 0;
+}
+
+uint64_t audioslicer_stream_committed(const audioslicer_stream *stream)
+{
+    return stream ? stream->stream.committed() : 0;
+}
+
+static int realtime_status(RealtimeStatus status)
+{
+    switch (status)
+    {
+        case RealtimeStatus::Ok:
+            return AUDIOSLICER_OK;
+        case RealtimeStatus::Overrun:
+            return AUDIOSLICER_ERROR_OVERRUN;
+        case RealtimeStatus::Rejected:
+            break;
+    }
+    return AUDIOSLICER_ERROR_INVALID_ARGUMENT;
+}
+
+int audioslicer_realtime_create(const audioslicer *slicer, unsigned int channels, uint64_t max_block_frames,
+                                uint64_t buffer_frames, audioslicer_realtime **realtime)
+{
+    if (!slicer || !realtime)
+    {
+        return fail(AUDIOSLICER_ERROR_INVALID_ARGUMENT, "Null argument");
+    }
+    *realtime = nullptr;
+    return guarded([&]()
+    {
+        *realtime = new audioslicer_realtime(slicer->slicer, channels, max_block_frames, buffer_frames);
+    });
+}
+
+void audioslicer_realtime_destroy(audioslicer_realtime *realtime)
+{
+    delete realtime;
+}
+
+// The two functions of the audio thread must not touch last_error, which may allocate.
+int audioslicer_realtime_process(audioslicer_realtime *realtime, const float *samples, uint64_t frames)
+{
+    if (!realtime || (!samples && frames > 0))
+    {
+        return AUDIOSLICER_ERROR_INVALID_ARGUMENT;
+    }
+    return realtime_status(realtime->slicer.process(samples, frames));
+}
+
+int audioslicer_realtime_finish(audioslicer_realtime *realtime)
+{
+    if (!realtime)
+    {
+        return AUDIOSLICER_ERROR_INVALID_ARGUMENT;
+    }
+    return realtime_status(realtime->slicer.finish());
+}
+
+int audioslicer_realtime_next_clip(audioslicer_realtime *realtime, audioslicer_chunk *chunk, const float **samples, int *ready)
+{
+    if (!realtime || !chunk || !samples || !ready)
+    {
+        return fail(AUDIOSLICER_ERROR_INVALID_ARGUMENT, "Null argument");
+    }
+    *ready = 0;
+    return guarded([&]()
+    {
+        if (realtime->reader.next_clip(realtime->clip, chunk->begin, chunk->end))
+        {
+            *samples = realtime->clip.data();
+            *ready = 1;
+        }
+    });
+}
+
+int audioslicer_realtime_finished(const audioslicer_realtime *realtime)
+{
+    return (realtime && realtime->reader.finished()) ? 1 : 0;
+}
@@ -0,0 +1,143 @@
+#ifndef AUDIO_SLICER_AUDIOSLICER_H
+#define AUDIO_SLICER_AUDIOSLICER_H
+
+/*
+ * C interface of libaudioslicer.
+ *
+ * Audio is passed as interleaved 32-bit float frames in buffers owned by the caller; the library
+ * never copies or keeps them. Boundaries are returned in arrays owned by the handle that produced
+ * them, valid until the next call on that handle or until it is destroyed. A handle must not be
+ * used from several threads at once, but different handles are independent.
+ *
+ * Functions returning int return AUDIOSLICER_OK or one of the negative error codes;
+ * audioslicer_last_error() then describes the failure of the calling thread's last call.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(AUDIOSLICER_STATIC)
+#define AUDIOSLICER_API
+#elif defined(_WIN32)
+#ifdef AUDIOSLICER_BUILDING
+#define AUDIOSLICER_API __declspec(dllexport)
+#else
+#define AUDIOSLICER_API __declspec(dllimport)
+#endif
+#else
+#define AUDIOSLICER_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIOSLICER_API_VERSION 2
+
+enum audioslicer_status {
+    AUDIOSLICER_OK = 0,
+    AUDIOSLICER_ERROR_INVALID_ARGUMENT = -1,
+    AUDIOSLICER_ERROR_OUT_OF_MEMORY = -2,
+    AUDIOSLICER_ERROR_INTERNAL = -3,
+    /* Real-time slicing: the writer fell behind, and audio or clips were lost. */
+    AUDIOSLICER_ERROR_OVERRUN = -4
+};
+
+/* How channels are combined for silence detection, see audioslicer_set_channel_mode(). */
+enum audioslicer_channel_mode {
+    AUDIOSLICER_CHANNELS_MIX = 0,
+    AUDIOSLICER_CHANNELS_MAX = 1,
+    AUDIOSLICER_CHANNELS_POWER = 2
+};
+
+typedef struct audioslicer_params {
+    double threshold_db;
+    uint64_t min_length_ms;
+    uint64_t min_interval_ms;
+    uint64_t hop_size_ms;
+    uint64_t max_sil_kept_ms;
+} audioslicer_params;
+
+/* A clip from frame begin (inclusive) to frame end (exclusive). */
+typedef struct audioslicer_chunk {
+    uint64_t begin;
+    uint64_t end;
+} audioslicer_chunk;
+
+typedef struct audioslicer audioslicer;
+typedef struct audioslicer_stream audioslicer_stream;
+typedef struct audioslicer_realtime audioslicer_realtime;
+
+AUDIOSLICER_API unsigned int audioslicer_api_version(void);
+AUDIOSLICER_API const char *audioslicer_last_error(void);
+
+/* Fills params with the defaults of the command line tool. */
+AUDIOSLICER_API void audioslicer_default_params(audioslicer_params *params);
+
+AUDIOSLICER_API int audioslicer_create(int sample_rate, const audioslicer_params *params, audioslicer **slicer);
+AUDIOSLICER_API void audioslicer_destroy(audioslicer *slicer);
+/* Splits clips longer than max_length_ms at their quietest points; 0 removes the limit. Batch slicing only. */
+AUDIOSLICER_API int audioslicer_set_max_length(audioslicer *slicer, uint64_t max_length_ms);
+/*
+ * MIX (the default) downmixes to mono, MAX follows the loudest channel so audio is kept while any
+ * channel is active, and POWER uses the RMS over all channels. Batch slicing only.
+ */
+AUDIOSLICER_API int audioslicer_set_channel_mode(audioslicer *slicer, int mode);
+/*
+ * Non-zero sums the analysis windows in single precision, which is faster. Levels then differ
+ * by a few parts per million, so a level that close to the threshold can be decided the other
+ * way and move a boundary. Batch slicing only.
+ */
+AUDIOSLICER_API int audioslicer_set_single_precision(audioslicer *slicer, int single_precision);
+
+/* Slices a complete waveform of the given number of frames. */
+AUDIOSLICER_API int audioslicer_slice(audioslicer *slicer, const float *samples, uint64_t frames, unsigned int channels,
+                                      const audioslicer_chunk **chunks, size_t *count);
+/* Same for 16-bit samples, without converting them to float first; full scale is 32768. */
+AUDIOSLICER_API int audioslicer_slice_int16(audioslicer *slicer, const int16_t *samples, uint64_t frames, unsigned int channels,
+                                            const audioslicer_chunk **chunks, size_t *count);
+
+/*
+ * Slices audio fed in blocks of any size. Each call reports the clips whose end became known,
+ * and audioslicer_stream_finish() the remaining ones; together they equal audioslicer_slice()
+ * on the whole waveform, except that a stream silent from start to end yields no clip. The
+ * stream keeps its own copy of the parameters, so the slicer it was created from may be destroyed.
+ */
+AUDIOSLICER_API int audioslicer_stream_create(const audioslicer *slicer, audioslicer_stream **stream);
+AUDIOSLICER_API void audioslicer_stream_destroy(audioslicer_stream *stream);
+AUDIOSLICER_API int audioslicer_stream_feed(audioslicer_stream *stream, const float *samples, uint64_t frames, unsigned int channels,
+                                            const audioslicer_chunk **chunks, size_t *count);
+AUDIOSLICER_API int audioslicer_stream_finish(audioslicer_stream *stream, const audioslicer_chunk **chunks, size_t *count);
+/* Frames fed so far, and the frame before which every frame is known to be in a reported clip, the open clip or silence. */
+AUDIOSLICER_API uint64_t audioslicer_stream_frames(const audioslicer_stream *stream);
+AUDIOSLICER_API uint64_t audioslicer_stream_committed(const audioslicer_stream *stream);
+
+/*
+ * Streaming for audio callbacks that must never allocate, lock or block. Everything is allocated
+ * by audioslicer_realtime_create(): blocks of up to max_block_frames frames are accepted, and
+ * buffer_frames frames of audio can wait for the writer thread. audioslicer_realtime_process()
+ * and audioslicer_realtime_finish() run on the audio thread; they return AUDIOSLICER_OK,
+ * AUDIOSLICER_ERROR_OVERRUN when the writer fell behind (the block is still analyzed, and lost
+ * audio reads as silence), or AUDIOSLICER_ERROR_INVALID_ARGUMENT for a block that is too large
+ * or comes after the end, and never set audioslicer_last_error(). Their cost per block is linear
+ * in its length, plus a search over at most three times max_sil_kept for each clip boundary.
+ *
+ * A single writer thread calls audioslicer_realtime_next_clip() repeatedly. It sets *ready to 1
+ * with the next clip, whose interleaved samples stay valid until the next call, or to 0 if none
+ * is complete yet. audioslicer_realtime_finished() tells when the stream has ended and all clips
+ * have been returned. The clips equal those of audioslicer_stream_feed().
+ */
+AUDIOSLICER_API int audioslicer_realtime_create(const audioslicer *slicer, unsigned int channels, uint64_t max_block_frames,
+                                                uint64_t buffer_frames, audioslicer_realtime **realtime);
+AUDIOSLICER_API void audioslicer_realtime_destroy(audioslicer_realtime *realtime);
+AUDIOSLICER_API int audioslicer_realtime_process(audioslicer_realtime *realtime, const float *samples, uint64_t frames);
+AUDIOSLICER_API int audioslicer_realtime_finish(audioslicer_realtime *realtime);
+AUDIOSLICER_API int audioslicer_realtime_next_clip(audioslicer_realtime *realtime, audioslicer_chunk *chunk, const float **samples,
+                                                   int *ready);
+AUDIOSLICER_API int audioslicer_realtime_finished(const audioslicer_realtime *realtime);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //AUDIO_SLICER_AUDIOSLICER_H
@@ -0,0 +1,377 @@
+#ifndef AUDIO_SLICER_BASICSLICER_H
+#define AUDIO_SLICER_BASICSLICER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "slicer.h"
+
+/*
+ * Sample policies: how a stored sample converts to a float of full scale 1.0. 16-bit samples
+ * convert exactly like libsndfile reads them as float, so both give the same envelope.
+ */
+template<class Sample>
+struct SampleTraits;
+
+template<>
+struct SampleTraits<float> {
+    static float to_float(float v)
+    {
+        return v;
+    }
+};
+
+template<>
+struct SampleTraits<int16_t> {
+    static float to_float(int16_t v)
+    {
+        return (float)v * (1.0f / 32768.0f);
+    }
+};
+
+// Detection rules: how the channels of a frame combine into the envelope, see ChannelMode.
+struct MixRule {
+    static constexpr ChannelMode MODE = ChannelMode::Mix;
+};
+
+struct MaxRule {
+    static constexpr ChannelMode MODE = ChannelMode::Max;
+};
+
+struct PowerRule {
+    static constexpr ChannelMode MODE = ChannelMode::Power;
+};
+
+// Channels argument of BasicSlicer for a count only known at run time.
+static constexpr unsigned int ANY_CHANNELS = 0;
+
+/*
+ * The analysis of Slicer, specialized at compile time for a sample type, a channel count (or
+ * ANY_CHANNELS), the type of the running window sums, and a detection rule, so that the
+ * common cases get loops the compiler can unroll without any per-sample dispatch. Slicer
+ * picks the instantiation for each input and keeps every decision after the envelope.
+ *
+ * The envelope uses centered, zero-padded windows of frame_length frames every hop_length
+ * frames. The Mix rule downmixes each frame on the fly rather than into a mono copy of the
+ * input; with double sums, the values are bit for bit those of the original implementation,
+ * and of RmsEnvelope. Float sums are not slid, see blocked_envelope, so each value is within a
+ * few parts per million of the double one.
+ */
+template<class Sample, unsigned int Channels, class Accumulator, class DetectionRule>
+class BasicSlicer {
+private:
+    static unsigned int channel_count(unsigned int channels)
+    {
+        return (Channels == ANY_CHANNELS) ? channels : Channels;
+    }
+
+    static float downmix(const Sample *frame, unsigned int channels)
+    {
+        // Same order of operations as the downmix of Slicer::slice has always used; mono differs
+        // only in the sign of a zero, which squares away.
+        if (channels == 1)
+        {
+            return SampleTraits<Sample>::to_float(frame[0]);
+        }
+        float s = 0;
+        for (unsigned int c = 0; c < channels; c++)
+        {
+            s += SampleTraits<Sample>::to_float(frame[c]) / (float)channels;
+        }
+        return s;
+    }
+
+    // Energy of a window from the sums of its lanes: one per channel, or a single one for Mix.
+    static double combine(const Accumulator *sums, unsigned int channels)
+    {
+        if (DetectionRule::MODE == ChannelMode::Mix)
+        {
+            return (double)sums[0];
+        }
+        if (DetectionRule::MODE == ChannelMode::Max)
+        {
+            return (double)*std::max_element(sums, sums + channels);
+        }
+        double energy = 0;
+        for (unsigned int c = 0; c < channels; c++)
+        {
+            energy += (double)sums[c];
+        }
+        return energy / (double)channels;
+    }
+
+    // Adds the values in hop order, after the loops, which then make no calls.
+    static void add_to_histogram(const double *rms, uint64_t count, RmsHistogram *histogram)
+    {
+        if (histogram)
+        {
+            for (uint64_t i = 0; i < count; i++)
+            {
+                histogram->add(rms[i]);
+            }
+        }
+    }
+
+    static std::vector<double> mixed_envelope(const Sample *waveform, uint64_t frames, unsigned int channels, uint64_t frame_length,
+                                              uint64_t hop_length, RmsHistogram *histogram)
+    {
+        channels = channel_count(channels);
+        uint64_t padding = frame_length / 2;
+        uint64_t rms_size = frames / hop_length + 1;
+        std::vector<double> rms(rms_size);
+        uint64_t left = 0;
+        uint64_t right = 0;
+        uint64_t hop_count = 0;
+        uint64_t rms_index = 0;
+        Accumulator val = 0;
+
+        auto square = [&](uint64_t i)
+        {
+            float s = downmix(waveform + i * channels, channels);
+            return (Accumulator)s * s;
+        };
+        // The sum is passed by value and nothing is called, so that it can stay in a register.
+        auto emit = [&](Accumulator sum)
+        {
+            rms[rms_index++] = std::sqrt(std::max(0.0, (double)sum / (double)frame_length));
+        };
+
+        // Initial condition: the frame is at the beginning of the padded input.
+        while ((right < padding) && (right < frames))
+        {
+            val += square(right);
+            right++;
+        }
+        emit(val);
+
+        // The left side of the frame is still in the padding.
+        while ((right < frame_length) && (right < frames) && (rms_index < rms_size))
+        {
+            val += square(right);
+            if (++hop_count == hop_length)
+            {
+                emit(val);
+                hop_count = 0;
+            }
+            right++;
+        }
+
+        if (frame_length < frames)
+        {
+            // Sliding through the input, one hop at a time so the inner loop has no branch.
+            while ((right < frames) && (rms_index < rms_size))
+            {
+                uint64_t steps = std::min(hop_length - hop_count, frames - right);
+                for (uint64_t k = 0; k < steps; k++)
+                {
+                    val += square(right + k) - square(left + k);
+                }
+                left += steps;
+                right += steps;
+                hop_count += steps;
+                if (hop_count == hop_length)
+                {
+                    emit(val);
+                    hop_count = 0;
+                }
+            }
+        }
+        else
+        {
+            while ((right < frame_length) && (rms_index < rms_size))
+            {
+                if (++hop_count == hop_length)
+                {
+                    emit(val);
+                    hop_count = 0;
+                }
+                right++;
+            }
+        }
+
+        // The right side of the frame is in the padding.
+        while ((left < frames) && (rms_index < rms_size))
+        {
+            val -= square(left);
+            if (++hop_count == hop_length)
+            {
+                emit(val);
+                hop_count = 0;
+            }
+            left++;
+            right++;
+        }
+        add_to_histogram(rms.data(), rms_index, histogram);
+        return rms;
+    }
+
+    static std::vector<double> channel_envelope(const Sample *waveform, uint64_t frames, unsigned int channels, uint64_t frame_length,
+                                                uint64_t hop_length, RmsHistogram *histogram)
+    {
+        /*
+         * The running sums of all channels sit side by side, so each frame updates them in one
+         * contiguous loop; channels are only combined when a hop is emitted. Position r of the
+         * padded signal adds frame r, if any, and drops frame r - frame_length.
+         */
+        channels = channel_count(channels);
+        uint64_t padding = frame_length / 2;
+        uint64_t rms_size = frames / hop_length + 1;
+        std::vector<double> rms(rms_size);
+        Accumulator fixed_sums[(Channels == ANY_CHANNELS) ? 1 : Channels] = {};
+        std::vector<Accumulator> any_sums((Channels == ANY_CHANNELS) ? channels : 0);
+        Accumulator *shared_sums = (Channels == ANY_CHANNELS) ? any_sums.data() : fixed_sums;
+        const Accumulator *sums = shared_sums;
+
+        auto advance = [&](uint64_t begin, uint64_t end)
+        {
+            // With a fixed count, the sums stay in registers for the whole hop.
+            Accumulator local_sums[(Channels == ANY_CHANNELS) ? 1 : Channels];
+            Accumulator *sums = (Channels == ANY_CHANNELS) ? shared_sums : local_sums;
+            std::copy(shared_sums, shared_sums + ((Channels == ANY_CHANNELS) ? 0 : channels), local_sums);
+            uint64_t add_end = std::min(end, std::min(frames, frame_length));
+            for (uint64_t r = begin; r < add_end; r++)
+            {
+                const Sample *in = waveform + r * channels;
+                for (unsigned int c = 0; c < channels; c++)
+                {
+                    Accumulator v = SampleTraits<Sample>::to_float(in[c]);
+                    sums[c] += v * v;
+                }
+            }
+            uint64_t slide_end = std::min(end, frames);
+            for (uint64_t r = std::max(begin, frame_length); r < slide_end; r++)
+            {
+                const Sample *in = waveform + r * channels;
+                const Sample *out = in - frame_length * channels;
+                for (unsigned int c = 0; c < channels; c++)
+                {
+                    Accumulator v = SampleTraits<Sample>::to_float(in[c]);
+                    Accumulator w = SampleTraits<Sample>::to_float(out[c]);
+                    sums[c] += v * v - w * w;
+                }
+            }
+            uint64_t drop_end = std::min(end, frames + frame_length);
+            for (uint64_t r = std::max(begin, std::max(frames, frame_length)); r < drop_end; r++)
+            {
+                const Sample *out = waveform + (r - frame_length) * channels;
+                for (unsigned int c = 0; c < channels; c++)
+                {
+                    Accumulator w = SampleTraits<Sample>::to_float(out[c]);
+                    sums[c] -= w * w;
+                }
+            }
+            std::copy(local_sums, local_sums + ((Channels == ANY_CHANNELS) ? 0 : channels), shared_sums);
+        };
+
+        uint64_t pos = 0;
+        for (uint64_t k = 0; k < rms_size; k++)
+        {
+            uint64_t target = padding + k * hop_length;
+            advance(pos, target);
+            pos = target;
+
+            rms[k] = std::sqrt(std::max(0.0, combine(sums, channels) / (double)frame_length));
+        }
+        add_to_histogram(rms.data(), rms_size, histogram);
+        return rms;
+    }
+
+    static std::vector<double> blocked_envelope(const Sample *waveform, uint64_t frames, unsigned int channels, uint64_t frame_length,
+                                                uint64_t hop_length, RmsHistogram *histogram)
+    {
+        /*
+         * A float sum slid through loud audio keeps the rounding error of the loud frames after
+         * they have left the window, which can exceed the energy of a quiet window many times
+         * over. Instead, the squares of every hop_length frames are summed into a block, and each
+         * window adds up the blocks it covers and its leftover frames afresh, so every sum only
+         * has positive terms of its own window. Window k covers the frames from
+         * k * hop_length + padding - frame_length to k * hop_length + padding, and block j
+         * starts where window j does.
+         */
+        channels = channel_count(channels);
+        unsigned int lanes = (DetectionRule::MODE == ChannelMode::Mix) ? 1 : channels;
+        int64_t padding = (int64_t)(frame_length / 2);
+        uint64_t rms_size = frames / hop_length + 1;
+        uint64_t whole = frame_length / hop_length;
+        int64_t origin = padding - (int64_t)frame_length;
+        int64_t hop = (int64_t)hop_length;
+        std::vector<double> rms(rms_size);
+        std::vector<Accumulator> blocks((size_t)((rms_size + whole) * lanes));
+        std::vector<Accumulator> window(lanes);
+
+        // Adds the squares of the frames from begin to end that exist to the lanes of sums.
+        auto add_squares = [&](int64_t begin, int64_t end, Accumulator *sums)
+        {
+            begin = std::max(begin, (int64_t)0);
+            end = std::min(end, (int64_t)frames);
+            if (DetectionRule::MODE == ChannelMode::Mix)
+            {
+                Accumulator sum = sums[0];
+                for (int64_t r = begin; r < end; r++)
+                {
+                    float s = downmix(waveform + r * channels, channels);
+                    sum += (Accumulator)s * s;
+                }
+                sums[0] = sum;
+                return;
+            }
+            // With a fixed count, the sums stay in registers for the whole range.
+            Accumulator local_sums[(Channels == ANY_CHANNELS) ? 1 : Channels];
+            Accumulator *lane_sums = (Channels == ANY_CHANNELS) ? sums : local_sums;
+            std::copy(sums, sums + ((Channels == ANY_CHANNELS) ? 0 : channels), local_sums);
+            for (int64_t r = begin; r < end; r++)
+            {
+                const Sample *in = waveform + r * channels;
+                for (unsigned int c = 0; c < channels; c++)
+                {
+                    Accumulator v = SampleTraits<Sample>::to_float(in[c]);
+                    lane_sums[c] += v * v;
+                }
+            }
+            std::copy(local_sums, local_sums + ((Channels == ANY_CHANNELS) ? 0 : channels), sums);
+        };
+
+        for (uint64_t j = 0; j < rms_size + whole; j++)
+        {
+            int64_t begin = origin + (int64_t)j * hop;
+            add_squares(begin, begin + hop, blocks.data() + j * lanes);
+        }
+        for (uint64_t k = 0; k < rms_size; k++)
+        {
+            std::fill(window.begin(), window.end(), (Accumulator)0);
+            for (uint64_t j = k; j < k + whole; j++)
+            {
+                for (unsigned int c = 0; c < lanes; c++)
+                {
+                    window[c] += blocks[j * lanes + c];
+                }
+            }
+            int64_t begin = origin + (int64_t)k * hop;
+            add_squares(begin + (int64_t)whole * hop, begin + (int64_t)frame_length, window.data());
+            rms[k] = std::sqrt(std::max(0.0, combine(window.data(), channels) / (double)frame_length));
+        }
+        add_to_histogram(rms.data(), rms_size, histogram);
+        return rms;
+    }
+
+public:
+    // RMS envelope of interleaved frames, one value per hop plus one; channels must match Channels unless ANY_CHANNELS.
+    static std::vector<double> envelope(const Sample *waveform, uint64_t frames, unsigned int channels, uint64_t frame_length,
+                                        uint64_t hop_length, RmsHistogram *histogram = nullptr)
+    {
+        if (!std::is_same<Accumulator, double>::value)
+        {
+            return blocked_envelope(waveform, frames, channels, frame_length, hop_length, histogram);
+        }
+        if (DetectionRule::MODE == ChannelMode::Mix)
+        {
+            return mixed_envelope(waveform, frames, channels, frame_length, hop_length, histogram);
+        }
+        return channel_envelope(waveform, frames, channels, frame_length, hop_length, histogram);
+    }
+};
+
+#endif //AUDIO_SLICER_BASICSLICER_H
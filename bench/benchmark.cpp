@@ -0,0 +1,458 @@
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <argparse/argparse.hpp>
+
+#include <sndfile.hh>
+
+/*
+ * Runs audio_slicer_cli over a corpus in several modes and reports the throughput of each run
+ * as JSON, so that runs on different commits can be compared. Whole batches are timed, so
+ * process start, file opens, decoding, clip creation and directory updates are all included.
+ */
+
+struct Mode {
+    const char *name;
+    std::vector<std::string> args;
+};
+
+static const std::vector<Mode> MODES = {
+        {"default", {}},
+        {"two_pass", {"--two_pass"}},
+        {"stats", {"--stats"}},
+        {"auto_threshold", {"--auto_threshold"}},
+        {"max_length", {"--max_length", "10000"}},
+        {"channel_max", {"--channel_mode", "max"}},
+        {"normalize", {"--normalize", "peak"}},
+        {"resample", {"--out_sr", "16000"}},
+};
+
+struct Corpus {
+    std::vector<std::string> files;
+    double seconds = 0.0;
+    uint64_t bytes = 0;
+};
+
+// Stages and counters as written by audio_slicer_cli --perf.
+static const char *const STAGES[] = {"decode", "analyze", "write"};
+static const char *const EVENTS[] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+static constexpr int STAGE_COUNT = 3;
+static constexpr int EVENT_COUNT = 4;
+
+// Sum of one stage over all inputs; each event is summed over the inputs it was counted for.
+struct StageTotal {
+    uint64_t inputs = 0;
+    double seconds = 0.0;
+    uint64_t events[EVENT_COUNT] = {};
+    // Rows that counted each event; rows without it are left out of its total.
+    uint64_t counted[EVENT_COUNT] = {};
+};
+
+struct RunResult {
+    std::string mode;
+    int repeat;
+    int exit_code;
+    double wall_seconds;
+    uint64_t peak_rss_bytes;
+    uint64_t output_files;
+    uint64_t output_bytes;
+    bool perf;
+    StageTotal stages[STAGE_COUNT];
+};
+
+static Corpus scan_corpus(const std::filesystem::path& dir)
+{
+    // Every file libsndfile can open is an input, in path order so the runs are comparable.
+    Corpus corpus;
+    std::vector<std::filesystem::path> paths;
+    for (const auto& item : std::filesystem::recursive_directory_iterator(dir))
+    {
+        if (item.is_regular_file())
+        {
+            paths.push_back(item.path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    for (const auto& path : paths)
+    {
+        SndfileHandle handle(path.string().c_str());
+        if (handle.error() || (handle.samplerate() <= 0))
+        {
+            continue;
+        }
+        corpus.files.push_back(path.string());
+        corpus.seconds += (double)handle.frames() / handle.samplerate();
+        corpus.bytes += (uint64_t)std::filesystem::file_size(path);
+    }
+    return corpus;
+}
+
+static int run_process(const std::vector<std::string>& args, uint64_t& peak_rss_bytes)
+{
+    std::vector<char *> argv;
+    for (const auto& arg : args)
+    {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        throw std::runtime_error("Cannot start " + args[0]);
+    }
+    if (pid == 0)
+    {
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    int status = 0;
+    struct rusage usage {};
+    if (wait4(pid, &status, 0, &usage) < 0)
+    {
+        throw std::runtime_error("Cannot wait for " + args[0]);
+    }
+#ifdef __APPLE__
+    uint64_t rss = (uint64_t)usage.ru_maxrss;
+#else
+    uint64_t rss = (uint64_t)usage.ru_maxrss * 1024;
+#endif
+    peak_rss_bytes = std::max(peak_rss_bytes, rss);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+static void add_perf(const std::filesystem::path& path, StageTotal *stages)
+{
+    // Rows of stage, seconds, the events (empty if not counted) and the input, which may contain commas.
+    std::ifstream is(path);
+    std::string line;
+    std::getline(is, line);
+    while (std::getline(is, line))
+    {
+        std::stringstream ss(line);
+        std::string stage, field;
+        std::getline(ss, stage, ',');
+        auto it = std::find(std::begin(STAGES), std::end(STAGES), stage);
+        if (it == std::end(STAGES) || !std::getline(ss, field, ','))
+        {
+            continue;
+        }
+        StageTotal& total = stages[it - std::begin(STAGES)];
+        total.inputs++;
+        total.seconds += std::strtod(field.c_str(), nullptr);
+        for (int i = 0; i < EVENT_COUNT; i++)
+        {
+            std::getline(ss, field, ',');
+            if (!field.empty())
+            {
+                total.counted[i]++;
+                total.events[i] += std::strtoull(field.c_str(), nullptr, 10);
+            }
+        }
+    }
+}
+
+/*
+ * Creates a directory of this run's own inside parent, so that concurrent runs given the same
+ * --scratch do not write to or delete each other's clips, and nothing already in parent is touched.
+ */
+static std::filesystem::path make_work_directory(const std::filesystem::path& parent)
+{
+    std::filesystem::create_directories(parent);
+    auto pattern = (parent / "audio_slicer_bench.XXXXXX").string();
+    if (mkdtemp(pattern.data()) == nullptr)
+    {
+        throw std::runtime_error("Cannot create a directory in " + parent.string());
+    }
+    return pattern;
+}
+
+static RunResult run_mode(const std::string& cli, const Mode& mode, const std::vector<std::string>& extra_args, const Corpus& corpus,
+                          const std::filesystem::path& work, size_t batch_bytes, bool perf, int repeat)
+{
+    /*
+     * The inputs are passed on the command line, in as many invocations as the limit on
+     * argument size needs; a batch of a few hundred KiB keeps the extra process starts
+     * negligible.
+     */
+    auto out = work / "out";
+    std::filesystem::remove_all(out);
+    std::filesystem::create_directories(out);
+    std::vector<std::string> base = {cli, "--out", out.string()};
+    base.insert(base.end(), mode.args.begin(), mode.args.end());
+    base.insert(base.end(), extra_args.begin(), extra_args.end());
+
+    // Counter reports go next to the output directory, so they are not counted as output.
+    auto perf_path = work / "perf.csv";
+
+    RunResult result {mode.name, repeat, 0, 0.0, 0, 0, 0, perf, {}};
+    auto start = std::chrono::steady_clock::now();
+    size_t next = 0;
+    while (next < corpus.files.size())
+    {
+        auto args = base;
+        if (perf)
+        {
+            args.insert(args.end(), {"--perf", perf_path.string()});
+        }
+        size_t size = 0;
+        while ((next < corpus.files.size()) && ((size == 0) || (size + corpus.files[next].size() + 1 <= batch_bytes)))
+        {
+            size += corpus.files[next].size() + 1;
+            args.push_back(corpus.files[next++]);
+        }
+        int code = run_process(args, result.peak_rss_bytes);
+        result.exit_code = std::max(result.exit_code, code);
+        if (perf)
+        {
+            // Reading the report is not part of the run.
+            auto batch_end = std::chrono::steady_clock::now();
+            add_perf(perf_path, result.stages);
+            start += std::chrono::steady_clock::now() - batch_end;
+        }
+    }
+    result.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::filesystem::remove(perf_path);
+
+    for (const auto& item : std::filesystem::recursive_directory_iterator(out))
+    {
+        if (item.is_regular_file())
+        {
+            result.output_files++;
+            result.output_bytes += (uint64_t)item.file_size();
+        }
+    }
+    return result;
+}
+
+static std::string json_string(const std::string& s)
+{
+    std::stringstream ss;
+    ss << '"';
+    for (unsigned char c : s)
+    {
+        if ((c == '"') || (c == '\\'))
+        {
+            ss << '\\' << c;
+        }
+        else if (c < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            ss << escaped;
+        }
+        else
+        {
+            ss << c;
+        }
+    }
+    ss << '"';
+    return ss.str();
+}
+
+static void write_json(std::ostream& os, const std::string& label, const std::string& cli, const std::vector<std::string>& extra_args,
+                       const Corpus& corpus, const std::vector<RunResult>& results)
+{
+    double hours = corpus.seconds / 3600.0;
+    os << "{\n"
+       << "  \"label\": " << json_string(label) << ",\n"
+       << "  \"cli\": " << json_string(cli) << ",\n"
+       << "  \"args\": [";
+    for (size_t i = 0; i < extra_args.size(); i++)
+    {
+        os << (i ? ", " : "") << json_string(extra_args[i]);
+    }
+    os << "],\n"
+       << "  \"corpus\": {\"files\": " << corpus.files.size() << ", \"audio_hours\": " << hours
+       << ", \"bytes\": " << corpus.bytes << "},\n"
+       << "  \"runs\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const auto& result = results[i];
+        double wall = std::max(result.wall_seconds, 1e-9);
+        os << "    {\"mode\": " << json_string(result.mode)
+           << ", \"repeat\": " << result.repeat
+           << ", \"exit_code\": " << result.exit_code
+           << ", \"wall_seconds\": " << result.wall_seconds
+           << ", \"files_per_second\": " << (double)corpus.files.size() / wall
+           << ", \"audio_hours_per_second\": " << hours / wall
+           << ", \"peak_rss_bytes\": " << result.peak_rss_bytes
+           << ", \"output_files\": " << result.output_files
+           << ", \"output_bytes\": " << result.output_bytes;
+        if (result.perf)
+        {
+            os << ", \"stages\": {";
+            for (int s = 0; s < STAGE_COUNT; s++)
+            {
+                const auto& stage = result.stages[s];
+                os << (s ? ", " : "") << json_string(STAGES[s]) << ": {\"seconds\": " << stage.seconds;
+                for (int e = 0; e < EVENT_COUNT; e++)
+                {
+                    os << ", " << json_string(EVENTS[e]) << ": ";
+                    if (stage.counted[e] > 0)
+                    {
+                        os << stage.events[e];
+                    }
+                    else
+                    {
+                        os << "null";
+                    }
+                }
+                // Instructions per cycle tell compute-bound code (high) from code waiting on memory (low).
+                os << ", \"ipc\": ";
+                if ((stage.counted[0] > 0) && (stage.counted[1] > 0) && (stage.events[0] > 0))
+                {
+                    os << (double)stage.events[1] / stage.events[0];
+                }
+                else
+                {
+                    os << "null";
+                }
+                os << "}";
+            }
+            os << "}";
+        }
+        os << "}" << ((i + 1 < results.size()) ? ",\n" : "\n");
+    }
+    os << "  ]\n"
+       << "}\n";
+}
+
+int main(int argc, char **argv)
+{
+    argparse::ArgumentParser parser("audio_slicer_bench");
+
+    std::string mode_names;
+    for (const auto& mode : MODES)
+    {
+        mode_names += (mode_names.empty() ? "" : ", ") + std::string(mode.name);
+    }
+    parser.add_argument("corpus")
+            .help("Directory of the corpus, e.g. written by audio_slicer_corpus");
+    parser.add_argument("--cli")
+            .default_value(std::string())
+            .help("Path of audio_slicer_cli (default: next to this program)");
+    parser.add_argument("--modes")
+            .default_value(std::string("default,two_pass,stats"))
+            .help("Modes to run, separated by commas: " + mode_names);
+    parser.add_argument("--args")
+            .default_value(std::string())
+            .help("Further arguments for every run, separated by spaces");
+    parser.add_argument("--repeat")
+            .default_value((int)(1))
+            .help("Runs of each mode")
+            .scan<'i', int>();
+    parser.add_argument("--scratch")
+            .default_value(std::string())
+            .help("Directory to write the clips in, inside a new subdirectory that is removed afterwards (default: the temporary directory)");
+    parser.add_argument("--batch_kb")
+            .default_value((uint64_t)(256))
+            .help("Maximum KiB of input paths per invocation of the CLI")
+            .scan<'i', uint64_t>();
+    parser.add_argument("--perf")
+            .default_value(false)
+            .implicit_value(true)
+            .help("Also report the time and hardware counters of each slicing stage, from audio_slicer_cli --perf");
+    parser.add_argument("--label")
+            .default_value(std::string())
+            .help("Copied to the report, e.g. the commit that was measured");
+    parser.add_argument("--json")
+            .default_value(std::string())
+            .help("Write the report to this file instead of standard output");
+
+    try {
+        parser.parse_args(argc, argv);
+    }
+    catch (const std::runtime_error& err) {
+        std::cerr << parser;
+        std::exit(1);
+    }
+
+    auto cli = parser.get("--cli");
+    if (cli.empty())
+    {
+        cli = (std::filesystem::absolute(argv[0]).parent_path() / "audio_slicer_cli").string();
+    }
+    std::vector<Mode> modes;
+    std::stringstream mode_list(parser.get("--modes"));
+    std::string name;
+    while (std::getline(mode_list, name, ','))
+    {
+        auto it = std::find_if(MODES.begin(), MODES.end(), [&](const Mode& mode) { return name == mode.name; });
+        if (it == MODES.end())
+        {
+            std::cerr << "Unknown mode: " << name << '\n';
+            std::exit(1);
+        }
+        modes.push_back(*it);
+    }
+    std::vector<std::string> extra_args;
+    std::stringstream arg_list(parser.get("--args"));
+    std::string arg;
+    while (arg_list >> arg)
+    {
+        extra_args.push_back(arg);
+    }
+    auto scratch = parser.get("--scratch").empty() ?
+            std::filesystem::temp_directory_path() : std::filesystem::path(parser.get("--scratch"));
+    std::filesystem::path work;
+
+    std::vector<RunResult> results;
+    Corpus corpus;
+    try
+    {
+        corpus = scan_corpus(parser.get("corpus"));
+        if (corpus.files.empty())
+        {
+            std::cerr << "No audio files in " << parser.get("corpus") << '\n';
+            std::exit(1);
+        }
+        work = make_work_directory(scratch);
+        for (const auto& mode : modes)
+        {
+            for (int repeat = 0; repeat < parser.get<int>("--repeat"); repeat++)
+            {
+                results.push_back(run_mode(cli, mode, extra_args, corpus, work, (size_t)parser.get<uint64_t>("--batch_kb") << 10,
+                                           parser.get<bool>("--perf"), repeat));
+                std::cerr << mode.name << ": " << results.back().wall_seconds << " s" << '\n';
+            }
+        }
+        std::filesystem::remove_all(work);
+    }
+    catch (const std::exception& err)
+    {
+        std::cerr << err.what() << '\n';
+        if (!work.empty())
+        {
+            std::error_code ec;
+            std::filesystem::remove_all(work, ec);
+        }
+        std::exit(2);
+    }
+
+    if (parser.get("--json").empty())
+    {
+        write_json(std::cout, parser.get("--label"), cli, extra_args, corpus, results);
+    }
+    else
+    {
+        std::ofstream os(parser.get("--json"), std::ios::trunc);
+        write_json(os, parser.get("--label"), cli, extra_args, corpus, results);
+    }
+    return 0;
+}
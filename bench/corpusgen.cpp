@@ -0,0 +1,294 @@
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+#include <argparse/argparse.hpp>
+
+#include <sndfile.hh>
+
+/*
+ * Writes a corpus of speech-like test recordings for benchmarking: bursts of harmonic tones
+ * with syllable-rate amplitude modulation, separated by pauses of low-level noise. Every file
+ * is generated from its own index and the seed with a portable generator, so the same
+ * arguments give the same corpus on every machine and standard library.
+ */
+
+static constexpr int BLOCK_FRAMES = 65536;
+static constexpr double PI = 3.14159265358979323846;
+
+// SplitMix64: tiny, and unlike std::*_distribution its output is specified exactly.
+class Random {
+private:
+    uint64_t state;
+
+public:
+    explicit Random(uint64_t seed)
+            : state(seed)
+    {}
+
+    uint64_t next()
+    {
+        uint64_t z = (this->state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    double uniform()
+    {
+        return (double)(next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    double uniform(double low, double high)
+    {
+        return low + (high - low) * uniform();
+    }
+
+    double exponential(double mean)
+    {
+        return -mean * std::log(1.0 - uniform());
+    }
+
+    template<class T>
+    const T& pick(const std::vector<T>& items)
+    {
+        return items[next() % items.size()];
+    }
+};
+
+struct OutputFormat {
+    std::string name;
+    std::string extension;
+    int format;
+};
+
+static OutputFormat parse_format(const std::string& name)
+{
+    if (name == "wav16") return {name, "wav", SF_FORMAT_WAV | SF_FORMAT_PCM_16};
+    if (name == "wav24") return {name, "wav", SF_FORMAT_WAV | SF_FORMAT_PCM_24};
+    if (name == "wavf") return {name, "wav", SF_FORMAT_WAV | SF_FORMAT_FLOAT};
+    if (name == "flac") return {name, "flac", SF_FORMAT_FLAC | SF_FORMAT_PCM_16};
+    if (name == "ogg") return {name, "ogg", SF_FORMAT_OGG | SF_FORMAT_VORBIS};
+    throw std::invalid_argument("Unknown format: " + name);
+}
+
+template<class T>
+static std::vector<T> parse_list(const std::string& list, T (*parse)(const std::string&))
+{
+    std::vector<T> items;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        items.push_back(parse(item));
+    }
+    if (items.empty())
+    {
+        throw std::invalid_argument("Empty list: " + list);
+    }
+    return items;
+}
+
+static int parse_positive(const std::string& s)
+{
+    size_t end = 0;
+    int value = std::stoi(s, &end);
+    if ((end != s.size()) || (value <= 0))
+    {
+        throw std::invalid_argument("Not a positive number: " + s);
+    }
+    return value;
+}
+
+struct SpeechPattern {
+    double speech_ms;
+    double pause_ms;
+    double noise_db;
+};
+
+static uint64_t write_file(const std::filesystem::path& path, const OutputFormat& format, int channels, int sr, uint64_t frames,
+                           const SpeechPattern& pattern, Random& random)
+{
+    SndfileHandle handle(path.string().c_str(), SFM_WRITE, format.format, channels, sr);
+    if (handle.error())
+    {
+        throw std::runtime_error("Cannot write " + path.string() + ": " + handle.strError());
+    }
+    double noise = std::pow(10.0, pattern.noise_db / 20.0);
+    // Channels differ a little in level, as microphones of one recording do.
+    std::vector<double> channel_gain(channels);
+    for (int c = 0; c < channels; c++)
+    {
+        channel_gain[c] = std::pow(10.0, random.uniform(-3.0, 0.0) / 20.0);
+    }
+
+    bool voiced = random.uniform() < 0.5;
+    uint64_t segment_left = 0;
+    double level = 0.0, pitch = 0.0, syllable_rate = 0.0, phase = 0.0, syllable_phase = 0.0;
+    std::vector<float> block((size_t)BLOCK_FRAMES * channels);
+    uint64_t written = 0;
+    while (written < frames)
+    {
+        auto count = (uint64_t)std::min<uint64_t>(BLOCK_FRAMES, frames - written);
+        for (uint64_t i = 0; i < count; i++)
+        {
+            if (segment_left == 0)
+            {
+                voiced = !voiced;
+                double ms = random.exponential(voiced ? pattern.speech_ms : pattern.pause_ms);
+                segment_left = std::max<uint64_t>(1, (uint64_t)(ms * sr / 1000.0));
+                level = std::pow(10.0, random.uniform(-20.0, -6.0) / 20.0);
+                pitch = random.uniform(90.0, 260.0);
+                syllable_rate = random.uniform(3.0, 6.0);
+                syllable_phase = 0.0;
+            }
+            segment_left--;
+
+            double sample = 0.0;
+            if (voiced)
+            {
+                // A few harmonics of a pitch, loudest in the middle of each syllable.
+                phase += 2.0 * PI * pitch / sr;
+                syllable_phase += 2.0 * PI * syllable_rate / sr;
+                double envelope = 0.5 - 0.5 * std::cos(syllable_phase);
+                for (int k = 1; k <= 5; k++)
+                {
+                    sample += std::sin(phase * k) / k;
+                }
+                sample *= level * envelope * 0.5;
+            }
+            for (int c = 0; c < channels; c++)
+            {
+                block[i * channels + c] = (float)(sample * channel_gain[c] + noise * random.uniform(-1.0, 1.0));
+            }
+        }
+        phase = std::fmod(phase, 2.0 * PI);
+        if (handle.writef(block.data(), (sf_count_t)count) != (sf_count_t)count)
+        {
+            throw std::runtime_error("Cannot write " + path.string() + ": " + handle.strError());
+        }
+        written += count;
+    }
+    return written;
+}
+
+int main(int argc, char **argv)
+{
+    argparse::ArgumentParser parser("audio_slicer_corpus");
+
+    parser.add_argument("out")
+            .help("Directory the corpus is written to");
+    parser.add_argument("--files")
+            .default_value((uint64_t)(100))
+            .help("Number of files")
+            .scan<'i', uint64_t>();
+    parser.add_argument("--files_per_dir")
+            .default_value((uint64_t)(1000))
+            .help("Files per subdirectory, to reproduce the directory layout of large corpora")
+            .scan<'i', uint64_t>();
+    parser.add_argument("--min_duration")
+            .default_value((double)(5.0))
+            .help("Shortest file in seconds")
+            .scan<'g', double>();
+    parser.add_argument("--max_duration")
+            .default_value((double)(60.0))
+            .help("Longest file in seconds")
+            .scan<'g', double>();
+    parser.add_argument("--channels")
+            .default_value(std::string("1,2"))
+            .help("Channel counts to choose from, separated by commas");
+    parser.add_argument("--sample_rates")
+            .default_value(std::string("44100"))
+            .help("Sample rates to choose from, separated by commas");
+    parser.add_argument("--formats")
+            .default_value(std::string("wav16"))
+            .help("Formats to choose from, separated by commas: wav16, wav24, wavf (32-bit float), flac or ogg (Vorbis)");
+    parser.add_argument("--speech_ms")
+            .default_value((double)(3000.0))
+            .help("Mean length of a speech burst in milliseconds")
+            .scan<'g', double>();
+    parser.add_argument("--pause_ms")
+            .default_value((double)(700.0))
+            .help("Mean length of a pause in milliseconds")
+            .scan<'g', double>();
+    parser.add_argument("--noise_db")
+            .default_value((double)(-60.0))
+            .help("Level of the noise floor in dBFS")
+            .scan<'g', double>();
+    parser.add_argument("--seed")
+            .default_value((uint64_t)(1))
+            .help("Seed of the corpus; the same seed and arguments give the same files")
+            .scan<'i', uint64_t>();
+
+    try {
+        parser.parse_args(argc, argv);
+    }
+    catch (const std::runtime_error& err) {
+        std::cerr << parser;
+        std::exit(1);
+    }
+
+    std::vector<int> channel_counts, sample_rates;
+    std::vector<OutputFormat> formats;
+    try
+    {
+        channel_counts = parse_list<int>(parser.get("--channels"), parse_positive);
+        sample_rates = parse_list<int>(parser.get("--sample_rates"), parse_positive);
+        formats = parse_list<OutputFormat>(parser.get("--formats"), parse_format);
+    }
+    catch (const std::exception& err)
+    {
+        std::cerr << err.what() << '\n';
+        std::exit(1);
+    }
+    auto files = parser.get<uint64_t>("--files");
+    auto files_per_dir = std::max<uint64_t>(1, parser.get<uint64_t>("--files_per_dir"));
+    auto min_duration = parser.get<double>("--min_duration");
+    auto max_duration = std::max(min_duration, parser.get<double>("--max_duration"));
+    auto seed = parser.get<uint64_t>("--seed");
+    SpeechPattern pattern {std::max(1.0, parser.get<double>("--speech_ms")), std::max(1.0, parser.get<double>("--pause_ms")),
+                           parser.get<double>("--noise_db")};
+    if (min_duration <= 0.0)
+    {
+        std::cerr << "--min_duration must be positive" << '\n';
+        std::exit(1);
+    }
+
+    std::filesystem::path out(parser.get("out"));
+    double seconds = 0.0;
+    uint64_t bytes = 0;
+    try
+    {
+        for (uint64_t index = 0; index < files; index++)
+        {
+            // Each file has its own generator, so changing --files keeps the files already generated.
+            Random random(seed * 0x9E3779B97F4A7C15ULL + index);
+            const auto& format = random.pick(formats);
+            int channels = random.pick(channel_counts);
+            int sr = random.pick(sample_rates);
+            auto frames = (uint64_t)(random.uniform(min_duration, max_duration) * sr);
+
+            std::stringstream dir, name;
+            dir << std::setw(4) << std::setfill('0') << index / files_per_dir;
+            name << "corpus_" << std::setw(6) << std::setfill('0') << index << '.' << format.extension;
+            auto path = out / dir.str() / name.str();
+            std::filesystem::create_directories(path.parent_path());
+            seconds += (double)write_file(path, format, channels, sr, frames, pattern, random) / sr;
+            bytes += (uint64_t)std::filesystem::file_size(path);
+        }
+    }
+    catch (const std::exception& err)
+    {
+        std::cerr << err.what() << '\n';
+        std::exit(2);
+    }
+    std::cout << files << " files, " << seconds / 3600.0 << " hours of audio, " << bytes << " bytes" << '\n';
+    return 0;
+}
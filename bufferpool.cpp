@@ -0,0 +1,244 @@
+#include <new>
+#include <utility>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "bufferpool.h"
+
+static constexpr size_t PAGE_SIZE_BYTES = 4096;
+static constexpr size_t HUGE_PAGE_SIZE_BYTES = 2 << 20;
+static constexpr size_t BUFFER_ALIGNMENT = 64;
+static constexpr size_t DEFAULT_POOL_BYTES = (size_t)1 << 30;
+
+
+BufferPool::Lease::Lease()
+        : pool(nullptr),
+          memory(nullptr),
+          capacity(0),
+          count(0)
+{}
+
+BufferPool::Lease::Lease(BufferPool *pool, void *memory, size_t capacity, uint64_t count)
+        : pool(pool),
+          memory(memory),
+          capacity(capacity),
+          count(count)
+{}
+
+BufferPool::Lease::Lease(Lease&& other) noexcept
+        : pool(std::exchange(other.pool, nullptr)),
+          memory(std::exchange(other.memory, nullptr)),
+          capacity(std::exchange(other.capacity, 0)),
+          count(std::exchange(other.count, 0))
+{}
+
+BufferPool::Lease& BufferPool::Lease::operator=(Lease&& other) noexcept
+{
+    if (this != &other)
+    {
+        this->release();
+        this->pool = std::exchange(other.pool, nullptr);
+        this->memory = std::exchange(other.memory, nullptr);
+        this->capacity = std::exchange(other.capacity, 0);
+        this->count = std::exchange(other.count, 0);
+    }
+    return *this;
+}
+
+BufferPool::Lease::~Lease()
+{
+    this->release();
+}
+
+float *BufferPool::Lease::data() const
+{
+    return static_cast<float *>(this->memory);
+}
+
+uint64_t BufferPool::Lease::size() const
+{
+    return this->count;
+}
+
+void BufferPool::Lease::release()
+{
+    if (this->pool)
+    {
+        this->pool->give_back(this->memory, this->capacity);
+    }
+    this->pool = nullptr;
+    this->memory = nullptr;
+    this->capacity = 0;
+    this->count = 0;
+}
+
+
+BufferPool::BufferPool(size_t max_bytes, bool huge_pages)
+        : max_bytes(max_bytes),
+          leased_bytes(0),
+          idle_bytes(0),
+          huge_pages(huge_pages)
+{}
+
+BufferPool::~BufferPool()
+{
+    // Leases must not outlive their pool; only idle buffers are left to free.
+    for (auto& block : this->idle)
+    {
+        deallocate(block.memory, block.capacity);
+    }
+}
+
+BufferPool::Lease BufferPool::acquire(uint64_t count)
+{
+    size_t bytes = round_capacity(std::max<size_t>((size_t)count * sizeof(float), 1), this->huge_pages);
+    std::vector<Block> evicted;
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while (true)
+        {
+            // Reuse the smallest idle buffer that is large enough.
+            auto best = this->idle.end();
+            for (auto it = this->idle.begin(); it != this->idle.end(); ++it)
+            {
+                if (it->capacity >= bytes && (best == this->idle.end() || it->capacity < best->capacity))
+                {
+                    best = it;
+                }
+            }
+            if (best != this->idle.end())
+            {
+                Block block = *best;
+                this->idle.erase(best);
+                this->idle_bytes -= block.capacity;
+                this->leased_bytes += block.capacity;
+                return {this, block.memory, block.capacity, count};
+            }
+
+            if (this->leased_bytes + bytes <= this->max_bytes || this->leased_bytes == 0)
+            {
+                this->evict(bytes, evicted);
+                this->leased_bytes += bytes;
+                break;
+            }
+            this->returned.wait(lock);
+        }
+    }
+
+    for (auto& block : evicted)
+    {
+        deallocate(block.memory, block.capacity);
+    }
+
+    void *memory;
+    try
+    {
+        memory = allocate(bytes, this->huge_pages);
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->leased_bytes -= bytes;
+        this->returned.notify_all();
+        throw;
+    }
+    return {this, memory, bytes, count};
+}
+
+void BufferPool::set_max_bytes(size_t max_bytes)
+{
+    std::vector<Block> evicted;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->max_bytes = max_bytes;
+        this->evict(0, evicted);
+    }
+    this->returned.notify_all();
+    for (auto& block : evicted)
+    {
+        deallocate(block.memory, block.capacity);
+    }
+}
+
+size_t BufferPool::get_max_bytes()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->max_bytes;
+}
+
+BufferPool& BufferPool::shared()
+{
+    static BufferPool pool(DEFAULT_POOL_BYTES);
+    return pool;
+}
+
+void BufferPool::give_back(void *memory, size_t capacity)
+{
+    std::vector<Block> evicted;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->leased_bytes -= capacity;
+        this->idle.push_back({memory, capacity});
+        this->idle_bytes += capacity;
+        this->evict(0, evicted);
+    }
+    this->returned.notify_all();
+    for (auto& block : evicted)
+    {
+        deallocate(block.memory, block.capacity);
+    }
+}
+
+void BufferPool::evict(size_t needed, std::vector<Block>& evicted)
+{
+    // Called with the mutex held: drops the largest idle buffers until the limit is respected.
+    while (!this->idle.empty() && this->leased_bytes + this->idle_bytes + needed > this->max_bytes)
+    {
+        auto largest = std::max_element(this->idle.begin(), this->idle.end(),
+                                        [](const Block& a, const Block& b) { return a.capacity < b.capacity; });
+        evicted.push_back(*largest);
+        this->idle_bytes -= largest->capacity;
+        this->idle.erase(largest);
+    }
+}
+
+size_t BufferPool::round_capacity(size_t bytes, bool huge_pages)
+{
+    size_t unit = (huge_pages && bytes >= HUGE_PAGE_SIZE_BYTES) ? HUGE_PAGE_SIZE_BYTES : PAGE_SIZE_BYTES;
+    return (bytes + unit - 1) / unit * unit;
+}
+
+void *BufferPool::allocate(size_t bytes, bool huge_pages)
+{
+#ifdef __linux__
+    void *memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        throw std::bad_alloc();
+    }
+#ifdef MADV_HUGEPAGE
+    if (huge_pages && bytes >= HUGE_PAGE_SIZE_BYTES)
+    {
+        // Only a hint: without transparent huge pages the mapping simply uses normal pages.
+        madvise(memory, bytes, MADV_HUGEPAGE);
+    }
+#endif
+    return memory;
+#else
+    (void)huge_pages;
+    return ::operator new(bytes, std::align_val_t(BUFFER_ALIGNMENT));
+#endif
+}
+
+void BufferPool::deallocate(void *memory, size_t bytes)
+{
+#ifdef __linux__
+    munmap(memory, bytes);
+#else
+    (void)bytes;
+    ::operator delete(memory, std::align_val_t(BUFFER_ALIGNMENT));
+#endif
+}
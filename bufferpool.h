@@ -0,0 +1,77 @@
+#ifndef AUDIO_SLICER_BUFFERPOOL_H
+#define AUDIO_SLICER_BUFFERPOOL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+/*
+ * Bounded pool of large sample buffers. Workers lease a buffer for decoding a file and give it
+ * back when done, so the memory stays mapped (and its pages faulted in) for the next file.
+ * The bytes leased and kept idle never exceed the limit: acquire() blocks until enough is
+ * returned, except that a single lease larger than the limit is granted when nothing else is
+ * leased. On Linux buffers are mapped directly and marked for transparent huge pages.
+ */
+class BufferPool {
+public:
+    class Lease {
+    private:
+        BufferPool *pool;
+        void *memory;
+        size_t capacity;
+        uint64_t count;
+
+        friend class BufferPool;
+        Lease(BufferPool *pool, void *memory, size_t capacity, uint64_t count);
+
+    public:
+        Lease();
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease();
+
+        float *data() const;
+        // Number of floats requested; the underlying buffer may be larger.
+        uint64_t size() const;
+        void release();
+    };
+
+private:
+    struct Block {
+        void *memory;
+        size_t capacity;
+    };
+
+    std::mutex mutex;
+    std::condition_variable returned;
+    std::vector<Block> idle;
+    size_t max_bytes;
+    size_t leased_bytes;
+    size_t idle_bytes;
+    bool huge_pages;
+
+    void give_back(void *memory, size_t capacity);
+    void evict(size_t needed, std::vector<Block>& evicted);
+    static size_t round_capacity(size_t bytes, bool huge_pages);
+    static void *allocate(size_t bytes, bool huge_pages);
+    static void deallocate(void *memory, size_t bytes);
+
+public:
+    explicit BufferPool(size_t max_bytes, bool huge_pages = true);
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+    ~BufferPool();
+
+    Lease acquire(uint64_t count);
+    void set_max_bytes(size_t max_bytes);
+    size_t get_max_bytes();
+
+    // Process-wide pool shared by all workers, 1 GiB by default.
+    static BufferPool& shared();
+};
+
+#endif //AUDIO_SLICER_BUFFERPOOL_H
@@ -0,0 +1,200 @@
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+#include "cache.h"
+#include "fields.h"
+#include "hash.h"
+
+// First line of a cache file, bumped whenever the layout changes.
+static const char CACHE_HEADER[] = "audio_slicer cache 2";
+
+static int64_t file_mtime(const std::filesystem::path& path)
+{
+    return (int64_t)std::filesystem::last_write_time(path).time_since_epoch().count();
+}
+
+uint64_t hash_file(const std::filesystem::path& path)
+{
+    std::ifstream is(path, std::ios::binary);
+    if (!is)
+    {
+        throw std::runtime_error("Cannot open " + path.string());
+    }
+    Hash64 hash;
+    std::vector<char> buffer(1 << 20);
+    while (is)
+    {
+        is.read(buffer.data(), (std::streamsize)buffer.size());
+        hash.update(buffer.data(), (size_t)is.gcount());
+    }
+    return hash.digest();
+}
+
+ResultCache::ResultCache(std::filesystem::path path)
+        : path(std::move(path)),
+          dirty(false),
+          appendable(false)
+{
+    /*
+     * One line per input: path, size, mtime, content hash, parameter hash, number of outputs
+     * and the outputs, separated by tabs, with the paths escaped by escape_field. A missing or
+     * unreadable cache is simply empty.
+     */
+    std::ifstream is(this->path);
+    std::string line;
+    if (!std::getline(is, line) || (line != CACHE_HEADER))
+    {
+        return;
+    }
+    this->appendable = true;
+    // A line cut short by a crash fails to parse or has too few outputs, and is skipped.
+    while (std::getline(is, line))
+    {
+        std::stringstream ss(line);
+        std::string input, field;
+        Entry entry {};
+        size_t output_count = 0;
+        if (!std::getline(ss, input, '\t'))
+        {
+            continue;
+        }
+        ss >> entry.size >> entry.mtime >> std::hex >> entry.content_hash >> entry.params_hash >> std::dec >> output_count;
+        if (ss.fail())
+        {
+            continue;
+        }
+        ss.ignore(1);
+        for (size_t i = 0; (i < output_count) && std::getline(ss, field, '\t'); i++)
+        {
+            entry.outputs.push_back(unescape_field(field));
+        }
+        if (entry.outputs.size() != output_count)
+        {
+            continue;
+        }
+        this->entries[unescape_field(input)] = std::move(entry);
+    }
+}
+
+bool ResultCache::lookup(const std::filesystem::path& input, uint64_t params_hash, std::vector<std::string> *outputs)
+{
+    auto it = this->entries.find(input.string());
+    if ((it == this->entries.end()) || (it->second.params_hash != params_hash))
+    {
+        return false;
+    }
+    Entry& entry = it->second;
+
+    std::error_code ec;
+    auto size = std::filesystem::file_size(input, ec);
+    if (ec || (size != entry.size))
+    {
+        return false;
+    }
+    for (const auto& output : entry.outputs)
+    {
+        if (!std::filesystem::exists(output, ec))
+        {
+            return false;
+        }
+    }
+    auto mtime = file_mtime(input);
+    if (mtime != entry.mtime)
+    {
+        // Touched but possibly unchanged: hashing is still much cheaper than decoding and slicing.
+        if (hash_file(input) != entry.content_hash)
+        {
+            return false;
+        }
+        entry.mtime = mtime;
+        this->dirty = true;
+    }
+    if (outputs)
+    {
+        *outputs = entry.outputs;
+    }
+    return true;
+}
+
+void ResultCache::store(const std::filesystem::path& input, uint64_t params_hash, const std::vector<std::filesystem::path>& outputs)
+{
+    Entry entry;
+    entry.size = std::filesystem::file_size(input);
+    entry.mtime = file_mtime(input);
+    entry.content_hash = hash_file(input);
+    entry.params_hash = params_hash;
+    for (const auto& output : outputs)
+    {
+        entry.outputs.push_back(output.string());
+    }
+    this->dirty = true;
+    if (!this->appendable)
+    {
+        // Nothing valid to append to: start the file with everything known so far.
+        this->entries[input.string()] = std::move(entry);
+        save();
+        return;
+    }
+    if (!this->appender.is_open())
+    {
+        // End a line cut short by a crash, so that it does not swallow the next entry.
+        char last = '\n';
+        std::ifstream is(this->path, std::ios::binary | std::ios::ate);
+        if (is && (is.tellg() > 0) && is.seekg(-1, std::ios::end))
+        {
+            is.get(last);
+        }
+        this->appender.open(this->path, std::ios::app);
+        if (last != '\n')
+        {
+            this->appender << '\n';
+        }
+    }
+    write_entry(this->appender, input.string(), entry);
+    if (!this->appender.flush())
+    {
+        throw std::runtime_error("Cannot write cache file " + this->path.string());
+    }
+    this->entries[input.string()] = std::move(entry);
+}
+
+void ResultCache::write_entry(std::ostream& os, const std::string& input, const Entry& entry)
+{
+    os << escape_field(input) << '\t' << entry.size << ' ' << entry.mtime << ' '
+       << std::hex << entry.content_hash << ' ' << entry.params_hash << ' ' << std::dec << entry.outputs.size();
+    for (const auto& output : entry.outputs)
+    {
+        os << '\t' << escape_field(output);
+    }
+    os << '\n';
+}
+
+void ResultCache::save()
+{
+    if (!this->dirty)
+    {
+        return;
+    }
+    // Write to a temporary file first, so an interrupted run never leaves a broken cache behind.
+    auto tmp_path = this->path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream os(tmp_path, std::ios::trunc);
+        os << CACHE_HEADER << '\n';
+        for (const auto& item : this->entries)
+        {
+            write_entry(os, item.first, item.second);
+        }
+        if (!os.flush())
+        {
+            throw std::runtime_error("Cannot write cache file " + tmp_path.string());
+        }
+    }
+    // Later entries are appended to the new file.
+    this->appender.close();
+    std::filesystem::rename(tmp_path, this->path);
+    this->dirty = false;
+    this->appendable = true;
+}
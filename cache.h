@@ -0,0 +1,50 @@
+#ifndef AUDIO_SLICER_CACHE_H
+#define AUDIO_SLICER_CACHE_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <filesystem>
+
+/*
+ * Remembers which inputs have already been sliced with which parameters, and the clips that
+ * were produced. An input is up to date when its parameters match and its size and
+ * modification time are unchanged (or, if only the time changed, its content hash is), and all
+ * of its recorded clips still exist.
+ *
+ * Every stored entry is appended to the file at once, so an interrupted batch keeps what it
+ * has sliced; a later line for the same input replaces an earlier one. save() rewrites the
+ * file with one line per input.
+ */
+class ResultCache {
+private:
+    struct Entry {
+        uint64_t size;
+        int64_t mtime;
+        uint64_t content_hash;
+        uint64_t params_hash;
+        std::vector<std::string> outputs;
+    };
+
+    std::filesystem::path path;
+    std::unordered_map<std::string, Entry> entries;
+    bool dirty;
+    // Whether the file exists with a valid header, so that entries can be appended to it.
+    bool appendable;
+    std::ofstream appender;
+
+    static void write_entry(std::ostream& os, const std::string& input, const Entry& entry);
+
+public:
+    explicit ResultCache(std::filesystem::path path);
+    // If the input is up to date and outputs is given, it receives the recorded outputs.
+    bool lookup(const std::filesystem::path& input, uint64_t params_hash, std::vector<std::string> *outputs = nullptr);
+    void store(const std::filesystem::path& input, uint64_t params_hash, const std::vector<std::filesystem::path>& outputs);
+    void save();
+};
+
+uint64_t hash_file(const std::filesystem::path& path);
+
+#endif //AUDIO_SLICER_CACHE_H
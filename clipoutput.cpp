@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <sndfile.hh>
+
+#include "clipoutput.h"
+
+// Page size, and the alignment O_DIRECT needs of addresses, offsets and lengths.
+static constexpr size_t ALIGNMENT = 4096;
+
+// Larger clips are written through a file handle rather than held in memory twice.
+static constexpr size_t MAX_BUFFER_BYTES = (size_t)256 << 20;
+
+// A buffer grown beyond this by an unusually long clip is not kept for the next one.
+static constexpr size_t MAX_KEPT_BYTES = (size_t)32 << 20;
+
+// Size of each write; large enough that a clip takes only a few.
+static constexpr size_t WRITE_CHUNK = (size_t)8 << 20;
+
+static size_t align_up(size_t bytes)
+{
+    return (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+ClipOutput::ClipOutput()
+        : buffer(nullptr),
+          capacity(0),
+          size(0),
+          position(0),
+          overflow(false)
+{}
+
+ClipOutput::~ClipOutput()
+{
+    if (this->buffer)
+    {
+        ::operator delete(this->buffer, std::align_val_t(ALIGNMENT));
+    }
+}
+
+ClipOutput& ClipOutput::for_thread()
+{
+    thread_local ClipOutput output;
+    return output;
+}
+
+bool ClipOutput::reserve(size_t bytes)
+{
+    if (bytes <= this->capacity)
+    {
+        return true;
+    }
+    if (bytes > MAX_BUFFER_BYTES)
+    {
+        return false;
+    }
+    size_t capacity = std::min(align_up(std::max(bytes, this->capacity * 2)), align_up(MAX_BUFFER_BYTES));
+    auto *buffer = static_cast<char *>(::operator new(capacity, std::align_val_t(ALIGNMENT)));
+    if (this->buffer)
+    {
+        std::memcpy(buffer, this->buffer, this->size);
+        ::operator delete(this->buffer, std::align_val_t(ALIGNMENT));
+    }
+    this->buffer = buffer;
+    this->capacity = capacity;
+    return true;
+}
+
+sf_count_t ClipOutput::vio_get_filelen(void *user_data)
+{
+    return (sf_count_t)static_cast<ClipOutput *>(user_data)->size;
+}
+
+sf_count_t ClipOutput::vio_seek(sf_count_t offset, int whence, void *user_data)
+{
+    auto *output = static_cast<ClipOutput *>(user_data);
+    sf_count_t base = (whence == SEEK_CUR) ? (sf_count_t)output->position : ((whence == SEEK_END) ? (sf_count_t)output->size : 0);
+    if (base + offset < 0)
+    {
+        return -1;
+    }
+    output->position = (size_t)(base + offset);
+    return (sf_count_t)output->position;
+}
+
+sf_count_t ClipOutput::vio_read(void *ptr, sf_count_t count, void *user_data)
+{
+    auto *output = static_cast<ClipOutput *>(user_data);
+    size_t available = (output->position < output->size) ? output->size - output->position : 0;
+    auto bytes = std::min((size_t)count, available);
+    std::memcpy(ptr, output->buffer + output->position, bytes);
+    output->position += bytes;
+    return (sf_count_t)bytes;
+}
+
+sf_count_t ClipOutput::vio_write(const void *ptr, sf_count_t count, void *user_data)
+{
+    auto *output = static_cast<ClipOutput *>(user_data);
+    size_t end = output->position + (size_t)count;
+    if (!output->reserve(end))
+    {
+        // A short write makes libsndfile fail, and the clip is written through a file handle instead.
+        output->overflow = true;
+        return 0;
+    }
+    if (output->position > output->size)
+    {
+        // Seeking past the end and writing leaves a hole, which reads back as zeros.
+        std::memset(output->buffer + output->size, 0, output->position - output->size);
+    }
+    std::memcpy(output->buffer + output->position, ptr, (size_t)count);
+    output->position = end;
+    output->size = std::max(output->size, end);
+    return count;
+}
+
+sf_count_t ClipOutput::vio_tell(void *user_data)
+{
+    return (sf_count_t)static_cast<ClipOutput *>(user_data)->position;
+}
+
+bool ClipOutput::encode(int format, int channels, int sr, const float *samples, uint64_t frames)
+{
+    // Uncompressed samples take at most four bytes; the header and metadata fit in one page.
+    uint64_t estimate = frames * (uint64_t)channels * 4 + ALIGNMENT;
+    if ((estimate > MAX_BUFFER_BYTES) || !reserve((size_t)estimate))
+    {
+        return false;
+    }
+    this->size = 0;
+    this->position = 0;
+    this->overflow = false;
+    {
+        SF_VIRTUAL_IO io {vio_get_filelen, vio_seek, vio_read, vio_write, vio_tell};
+        SndfileHandle handle(io, this, SFM_WRITE, format, channels, sr);
+        if (handle.error() || (handle.writef(samples, (sf_count_t)frames) != (sf_count_t)frames))
+        {
+            return false;
+        }
+    }
+    // The header is finished when the handle closes, which can still run out of room.
+    return !this->overflow;
+}
+
+bool ClipOutput::write(const std::filesystem::path& path, int format, int channels, int sr, const float *samples, uint64_t frames,
+                       bool direct)
+{
+    bool encoded = encode(format, channels, sr, samples, frames);
+    if (encoded)
+    {
+        write_file(path, direct);
+    }
+    if (this->capacity > MAX_KEPT_BYTES)
+    {
+        ::operator delete(this->buffer, std::align_val_t(ALIGNMENT));
+        this->buffer = nullptr;
+        this->capacity = 0;
+        this->size = 0;
+    }
+    return encoded;
+}
+
+void ClipOutput::write_file(const std::filesystem::path& path, bool direct)
+{
+#ifdef __linux__
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    int fd = direct ? open(path.c_str(), flags | O_DIRECT, 0666) : -1;
+    // tmpfs and some network file systems refuse O_DIRECT; the file is then written as usual.
+    bool is_direct = (fd >= 0);
+    if (fd < 0)
+    {
+        fd = open(path.c_str(), flags, 0666);
+    }
+    if (fd < 0)
+    {
+        throw std::runtime_error("Cannot write " + path.string() + ": " + std::strerror(errno));
+    }
+
+    // One extent of the exact size, instead of growing the file write by write.
+    if (this->size > 0)
+    {
+        fallocate(fd, 0, 0, (off_t)this->size);
+    }
+    // Direct writes must cover whole pages, so the last one is padded and the file cut back afterwards.
+    size_t length = this->size;
+    if (is_direct)
+    {
+        length = align_up(this->size);
+        reserve(length);
+        std::memset(this->buffer + this->size, 0, length - this->size);
+    }
+    size_t offset = 0;
+    while (offset < length)
+    {
+        ssize_t written = pwrite(fd, this->buffer + offset, std::min(WRITE_CHUNK, length - offset), (off_t)offset);
+        if ((written < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        if ((written < 0) && (errno == EINVAL) && is_direct)
+        {
+            // The file system wants a larger alignment than a page; finish without O_DIRECT.
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+            is_direct = false;
+            length = this->size;
+            continue;
+        }
+        if (written <= 0)
+        {
+            int error = errno;
+            close(fd);
+            throw std::runtime_error("Cannot write " + path.string() + ": " + std::strerror(error));
+        }
+        offset += (size_t)written;
+    }
+    if ((length != this->size) && (ftruncate(fd, (off_t)this->size) != 0))
+    {
+        int error = errno;
+        close(fd);
+        throw std::runtime_error("Cannot write " + path.string() + ": " + std::strerror(error));
+    }
+    if (close(fd) != 0)
+    {
+        throw std::runtime_error("Cannot write " + path.string() + ": " + std::strerror(errno));
+    }
+#else
+    (void)direct;
+    std::ofstream os(path, std::ios::binary | std::ios::trunc);
+    os.write(this->buffer, (std::streamsize)this->size);
+    if (!os.flush())
+    {
+        throw std::runtime_error("Cannot write " + path.string());
+    }
+#endif
+}
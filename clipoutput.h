@@ -0,0 +1,53 @@
+#ifndef AUDIO_SLICER_CLIPOUTPUT_H
+#define AUDIO_SLICER_CLIPOUTPUT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+
+#include <sndfile.h>
+
+/*
+ * Writes clips whose samples are all in memory. libsndfile encodes each clip into a buffer
+ * through its virtual I/O, header included; the file is then preallocated to its exact size
+ * and written with a few large writes (on Linux), instead of the many small buffered writes
+ * and header updates of a file handle. The buffer is page-aligned and kept for the next clip.
+ */
+class ClipOutput {
+private:
+    char *buffer;
+    size_t capacity;
+    size_t size;
+    size_t position;
+    bool overflow;
+
+    bool reserve(size_t bytes);
+    bool encode(int format, int channels, int sr, const float *samples, uint64_t frames);
+    void write_file(const std::filesystem::path& path, bool direct);
+
+    static sf_count_t vio_get_filelen(void *user_data);
+    static sf_count_t vio_seek(sf_count_t offset, int whence, void *user_data);
+    static sf_count_t vio_read(void *ptr, sf_count_t count, void *user_data);
+    static sf_count_t vio_write(const void *ptr, sf_count_t count, void *user_data);
+    static sf_count_t vio_tell(void *user_data);
+
+public:
+    ClipOutput();
+    ~ClipOutput();
+    ClipOutput(const ClipOutput&) = delete;
+    ClipOutput& operator=(const ClipOutput&) = delete;
+
+    /*
+     * Writes interleaved samples as a sound file. With direct, the file is written past the page
+     * cache (O_DIRECT) where the file system allows it, which keeps bulk jobs from evicting
+     * everything else. Returns false, writing nothing, if the encoded clip would not fit the
+     * buffer limit; throws std::runtime_error on I/O errors.
+     */
+    bool write(const std::filesystem::path& path, int format, int channels, int sr, const float *samples, uint64_t frames,
+               bool direct = false);
+
+    // The buffer of the calling thread, so that every worker reuses its own.
+    static ClipOutput& for_thread();
+};
+
+#endif //AUDIO_SLICER_CLIPOUTPUT_H
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#if (defined(WIN32) || defined(_WIN32) || defined(__WIN32)) || (defined(UNICODE) || defined(_UNICODE))
+#define USE_WIDE_CHAR
+#endif
+
+#include "decoder.h"
+#include "ioschedule.h"
+
+// Ranges shorter than this are not worth a thread and another open handle.
+static constexpr sf_count_t MIN_SEGMENT_FRAMES = (sf_count_t)1 << 20;
+
+
+static bool has_exact_seek(int format)
+{
+    int major = format & SF_FORMAT_TYPEMASK;
+    int minor = format & SF_FORMAT_SUBMASK;
+    return (major == SF_FORMAT_FLAC) ||
+           ((major == SF_FORMAT_OGG) && ((minor == SF_FORMAT_VORBIS) || (minor == SF_FORMAT_OPUS)));
+}
+
+static sf_count_t read_segment(const std::filesystem::path& path, int channels, float *buffer, sf_count_t begin, sf_count_t count)
+{
+#ifdef USE_WIDE_CHAR
+    SndfileHandle segment(path.wstring().c_str());
+#else
+    // Each range is read front to back, like a whole input.
+    SndfileHandle segment = open_sequential(path);
+#endif
+    if (segment.error() || (segment.channels() != channels) || (segment.seek(begin, SEEK_SET) != begin))
+    {
+        return -1;
+    }
+    return segment.readf(buffer + begin * channels, count);
+}
+
+sf_count_t decode_frames(SndfileHandle& handle, const std::filesystem::path& path, float *buffer, sf_count_t frames,
+                         unsigned int threads)
+{
+    auto segments = (sf_count_t)std::min<unsigned int>(threads, (unsigned int)std::min<sf_count_t>(frames / MIN_SEGMENT_FRAMES, 1024));
+    if ((segments <= 1) || !has_exact_seek(handle.format()))
+    {
+        return handle.readf(buffer, frames);
+    }
+
+    int channels = handle.channels();
+    std::vector<sf_count_t> bounds(segments + 1);
+    for (sf_count_t i = 0; i <= segments; i++)
+    {
+        bounds[i] = frames * i / segments;
+    }
+    std::vector<sf_count_t> counts(segments, -1);
+    std::vector<std::thread> workers;
+    workers.reserve(segments - 1);
+    try
+    {
+        for (sf_count_t i = 1; i < segments; i++)
+        {
+            workers.emplace_back([&, i]()
+            {
+                try
+                {
+                    counts[i] = read_segment(path, channels, buffer, bounds[i], bounds[i + 1] - bounds[i]);
+                }
+                catch (...)
+                {
+                    counts[i] = -1;
+                }
+            });
+        }
+    }
+    catch (const std::system_error&)
+    {
+        // Out of threads: the ones started must finish before the buffer is read serially.
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        return handle.readf(buffer, frames);
+    }
+    counts[0] = handle.readf(buffer, bounds[1]);
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    for (sf_count_t i = 0; i < segments; i++)
+    {
+        if (counts[i] != bounds[i + 1] - bounds[i])
+        {
+            // A decoder that cannot seek or read where the header promised; trust only a serial read.
+            handle.seek(0, SEEK_SET);
+            return handle.readf(buffer, frames);
+        }
+    }
+    return frames;
+}
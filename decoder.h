@@ -0,0 +1,21 @@
+#ifndef AUDIO_SLICER_DECODER_H
+#define AUDIO_SLICER_DECODER_H
+
+#include <filesystem>
+
+#include <sndfile.hh>
+
+/*
+ * Decodes the first frames of an open file into buffer, as handle.readf(buffer, frames) would.
+ * Compressed formats whose seeking is sample-exact (FLAC, Ogg Vorbis and Opus) are split into up
+ * to `threads` ranges of frames; the first is decoded with handle and each other one on its own
+ * thread with its own handle, opened from path and positioned with sf_seek, straight into its
+ * slot of buffer. Other formats, short files and threads <= 1 are read serially, as is the file
+ * when threads cannot be started. If any range comes back short, the whole file is read again
+ * serially, so the result never differs from a serial decode. Leaves handle at an unspecified position; returns the number of frames decoded.
+ */
+sf_count_t decode_frames(SndfileHandle& handle, const std::filesystem::path& path, float *buffer, sf_count_t frames,
+                         unsigned int threads);
+
+
+#endif //AUDIO_SLICER_DECODER_H
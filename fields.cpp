@@ -0,0 +1,65 @@
+#include "fields.h"
+
+static int hex_digit(char c)
+{
+    if ((c >= '0') && (c <= '9'))
+    {
+        return c - '0';
+    }
+    if ((c >= 'A') && (c <= 'F'))
+    {
+        return c - 'A' + 10;
+    }
+    if ((c >= 'a') && (c <= 'f'))
+    {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+std::string escape_field(const std::string& field)
+{
+    static const char DIGITS[] = "0123456789ABCDEF";
+    std::string escaped;
+    escaped.reserve(field.size());
+    for (char c : field)
+    {
+        if ((c == '%') || (c == '\t') || (c == '\n') || (c == '\r'))
+        {
+            escaped += '%';
+            escaped += DIGITS[(unsigned char)c >> 4];
+            escaped += DIGITS[(unsigned char)c & 0xf];
+        }
+        else
+        {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+std::string unescape_field(const std::string& field)
+{
+    std::string unescaped;
+    unescaped.reserve(field.size());
+    for (size_t i = 0; i < field.size(); i++)
+    {
+        int high = -1;
+        int low = -1;
+        if ((field[i] == '%') && (i + 2 < field.size()))
+        {
+            high = hex_digit(field[i + 1]);
+            low = hex_digit(field[i + 2]);
+        }
+        if ((high >= 0) && (low >= 0))
+        {
+            unescaped += (char)((high << 4) | low);
+            i += 2;
+        }
+        else
+        {
+            unescaped += field[i];
+        }
+    }
+    return unescaped;
+}
@@ -0,0 +1,16 @@
+#ifndef AUDIO_SLICER_FIELDS_H
+#define AUDIO_SLICER_FIELDS_H
+
+#include <string>
+
+/*
+ * Escapes a field of the tab-separated journal, cache and manifest files, so that paths
+ * containing tabs or line breaks do not split a line: '%', tab, newline and carriage return are
+ * written as %25, %09, %0A and %0D. Everything else, backslashes included, is kept as is.
+ */
+std::string escape_field(const std::string& field);
+
+// Reverses escape_field. A '%' not followed by two hex digits is kept as is.
+std::string unescape_field(const std::string& field);
+
+#endif //AUDIO_SLICER_FIELDS_H
@@ -0,0 +1,92 @@
+#include <utility>
+
+#include <sndfile.h>
+
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFileInfo>
+
+#include "dirscanner.h"
+
+static constexpr int SCAN_BATCH_SIZE = 512;
+static constexpr qint64 SCAN_BATCH_INTERVAL_MS = 200;
+
+const QSet<QString> &audioFileExtensions()
+{
+    static const QSet<QString> extensions = []()
+    {
+        QSet<QString> result;
+        int count = 0;
+        sf_command(nullptr, SFC_GET_FORMAT_MAJOR_COUNT, &count, sizeof(int));
+        for (int i = 0; i < count; i++)
+        {
+            SF_FORMAT_INFO info;
+            info.format = i;
+            if (sf_command(nullptr, SFC_GET_FORMAT_MAJOR, &info, sizeof(info)) == 0 && info.extension)
+            {
+                result.insert(QString::fromLatin1(info.extension).toLower());
+            }
+        }
+        // Common alternative spellings of the extensions reported above.
+        result.insert("wav");
+        result.insert("aif");
+        result.insert("aiff");
+        result.insert("oga");
+        result.insert("opus");
+        return result;
+    }();
+    return extensions;
+}
+
+bool isAudioFile(const QString &path)
+{
+    return audioFileExtensions().contains(QFileInfo(path).suffix().toLower());
+}
+
+DirScanner::DirScanner(QStringList roots, std::shared_ptr<std::atomic<bool>> cancelled)
+        : m_roots(std::move(roots)),
+          m_cancelled(std::move(cancelled))
+{}
+
+void DirScanner::run()
+{
+    const auto &extensions = audioFileExtensions();
+    QStringList batch;
+    QElapsedTimer timer;
+    timer.start();
+
+    for (const QString &root : m_roots)
+    {
+        QDirIterator it(root, QDir::Files | QDir::Readable, QDirIterator::Subdirectories);
+        while (it.hasNext())
+        {
+            if (m_cancelled->load(std::memory_order_relaxed))
+            {
+                emit scanFinished();
+                return;
+            }
+
+            QString path = it.next();
+            QString suffix = it.fileInfo().suffix().toLower();
+            if (!extensions.contains(suffix))
+            {
+                continue;
+            }
+
+            batch.append(path);
+            if (batch.size() >= SCAN_BATCH_SIZE || timer.elapsed() >= SCAN_BATCH_INTERVAL_MS)
+            {
+                emit filesFound(batch);
+                batch.clear();
+                timer.restart();
+            }
+        }
+    }
+
+    if (!batch.isEmpty() && !m_cancelled->load(std::memory_order_relaxed))
+    {
+        emit filesFound(batch);
+    }
+    emit scanFinished();
+}
@@ -0,0 +1,35 @@
+#ifndef AUDIO_SLICER_DIRSCANNER_H
+#define AUDIO_SLICER_DIRSCANNER_H
+
+#include <atomic>
+#include <memory>
+
+#include <QObject>
+#include <QRunnable>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+// Lower-case extensions of every major format libsndfile can read.
+const QSet<QString> &audioFileExtensions();
+bool isAudioFile(const QString &path);
+
+// Walks directories recursively on a pool thread and reports audio files in batches,
+// so that the UI thread only ever inserts a few hundred rows at a time.
+class DirScanner : public QObject, public QRunnable {
+Q_OBJECT
+public:
+    DirScanner(QStringList roots, std::shared_ptr<std::atomic<bool>> cancelled);
+    void run() override;
+
+private:
+    QStringList m_roots;
+    std::shared_ptr<std::atomic<bool>> m_cancelled;
+
+signals:
+    void filesFound(const QStringList &paths);
+    void scanFinished();
+};
+
+
+#endif //AUDIO_SLICER_DIRSCANNER_H
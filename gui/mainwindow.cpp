@@ -6,10 +6,19 @@
 #include <QValidator>
 #include <QThreadPool>
 #include <QRunnable>
+#include <QTimer>
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+
+#include <set>
 
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "workthread.h"
+#include "dirscanner.h"
+#include "../slicer.h"
+#include "../hash.h"
 
 
 
@@ -21,8 +30,31 @@ MainWindow::MainWindow(QWidget *parent) :
     m_threadpool = new QThreadPool(this);
     m_threadpool->setMaxThreadCount(1);
 
+    m_model = new TaskListModel(this);
+    ui->listViewTaskList->setModel(m_model);
+    connect(ui->listViewTaskList->selectionModel(), SIGNAL(currentChanged(const QModelIndex &, const QModelIndex &)),
+            this, SLOT(slot_previewSelected(const QModelIndex &)));
+
+    // Hop size and minimum interval change the envelope itself, so the preview is decoded
+    // again once they have stopped changing for a moment.
+    qRegisterMetaType<PreviewDataPtr>("PreviewDataPtr");
+    m_previewCancelled = std::make_shared<std::atomic<bool>>(false);
+    m_previewTimer = new QTimer(this);
+    m_previewTimer->setSingleShot(true);
+    m_previewTimer->setInterval(300);
+    connect(m_previewTimer, SIGNAL(timeout()),
+            this, SLOT(slot_previewReload()));
+
+    // Progress and task status are repainted at most this often, however fast tasks finish.
+    m_statusTimer = new QTimer(this);
+    m_statusTimer->setInterval(100);
+    connect(m_statusTimer, SIGNAL(timeout()),
+            this, SLOT(slot_updateStatus()));
+
     connect(ui->pushButtonAddFiles, SIGNAL(clicked(bool)),
             this, SLOT(slot_add_audio_files()));
+    connect(ui->pushButtonAddFolder, SIGNAL(clicked(bool)),
+            this, SLOT(slot_add_folder()));
     connect(ui->pushButtonBrowse, SIGNAL(clicked(bool)),
             this, SLOT(slot_browse_output_dir()));
     connect(ui->pushButtonClearList, SIGNAL(clicked(bool)),
@@ -31,6 +63,16 @@ MainWindow::MainWindow(QWidget *parent) :
             this, SLOT(slot_about()));
     connect(ui->pushButtonStart, SIGNAL(clicked(bool)),
             this, SLOT(slot_start()));
+    connect(ui->comboBoxNormalize, SIGNAL(currentIndexChanged(int)),
+            this, SLOT(slot_normalizeChanged(int)));
+    connect(ui->horizontalSliderThreshold, SIGNAL(valueChanged(int)),
+            this, SLOT(slot_thresholdSliderMoved(int)));
+    for (auto lineEdit : {ui->lineEditThreshold, ui->lineEditMinLen, ui->lineEditMinInterval,
+                          ui->lineEditHopSize, ui->lineEditMaxSilence})
+    {
+        connect(lineEdit, SIGNAL(textChanged(const QString &)),
+                this, SLOT(slot_previewSettingsChanged()));
+    }
 
     ui->progressBar->setMinimum(0);
     ui->progressBar->setMaximum(100);
@@ -42,10 +84,15 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->lineEditMinInterval->setValidator(validator);
     ui->lineEditHopSize->setValidator(validator);
     ui->lineEditMaxSilence->setValidator(validator);
+    ui->lineEditTargetLevel->setValidator(new QDoubleValidator());
+    ui->lineEditOutputRate->setValidator(validator);
 
     m_workTotal = 0;
     m_workFinished = 0;
+    m_workRunning = 0;
+    m_nextTask = 0;
     m_processing = false;
+    m_scanCancelled = std::make_shared<std::atomic<bool>>(false);
 
     setWindowTitle(QApplication::applicationName());
     setAcceptDrops(true);
@@ -65,6 +112,8 @@ MainWindow::MainWindow(QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
+    cancelScans();
+    m_previewCancelled->store(true);
 #ifdef Q_OS_WIN
     if (m_pTaskbarList3)
     {
@@ -94,13 +143,68 @@ void MainWindow::slot_add_audio_files()
         return;
     }
 
-    QStringList paths = QFileDialog::getOpenFileNames(this, "Select Audio Files", ".", "Wave Files (*.wav)");
-    for (const QString& path : paths)
+    QStringList patterns;
+    for (const QString &ext : audioFileExtensions())
+    {
+        patterns.append("*." + ext);
+    }
+    patterns.sort();
+    QString filter = QString("Audio Files (%1);;All Files (*)").arg(patterns.join(' '));
+
+    QStringList paths = QFileDialog::getOpenFileNames(this, "Select Audio Files", ".", filter);
+    m_model->addPaths(paths);
+}
+
+void MainWindow::slot_add_folder()
+{
+    if (m_processing)
+    {
+        warningProcessNotFinished();
+        return;
+    }
+
+    QString path = QFileDialog::getExistingDirectory(this, "Select Folder", ".");
+    if (!path.isEmpty())
     {
-        auto *item = new QListWidgetItem();
-        item->setText(QFileInfo(path).fileName());
-        item->setData(Qt::ItemDataRole::UserRole + 1, path);
-        ui->listWidgetTaskList->addItem(item);
+        scanDirectories(QStringList(path));
+    }
+}
+
+void MainWindow::scanDirectories(const QStringList &dirs)
+{
+    // Scanners run on the global pool so that they never wait behind slicing tasks.
+    auto scanner = new DirScanner(dirs, m_scanCancelled);
+    connect(scanner, SIGNAL(filesFound(const QStringList &)),
+            this, SLOT(slot_filesFound(const QStringList &)));
+    connect(scanner, SIGNAL(scanFinished()),
+            this, SLOT(slot_scanFinished()));
+    m_scanners.insert(scanner);
+    ui->pushButtonAddFolder->setText("Scanning...");
+    QThreadPool::globalInstance()->start(scanner);
+}
+
+void MainWindow::cancelScans()
+{
+    // Batches already queued by cancelled scanners are dropped in slot_filesFound.
+    m_scanCancelled->store(true);
+    m_scanCancelled = std::make_shared<std::atomic<bool>>(false);
+    m_scanners.clear();
+    ui->pushButtonAddFolder->setText("Add Folder...");
+}
+
+void MainWindow::slot_filesFound(const QStringList &paths)
+{
+    if (m_scanners.contains(sender()))
+    {
+        m_model->addPaths(paths);
+    }
+}
+
+void MainWindow::slot_scanFinished()
+{
+    if (m_scanners.remove(sender()) && m_scanners.isEmpty())
+    {
+        ui->pushButtonAddFolder->setText("Add Folder...");
     }
 }
 
@@ -112,7 +216,12 @@ void MainWindow::slot_clear_audio_list()
         return;
     }
 
-    ui->listWidgetTaskList->clear();
+    cancelScans();
+    m_model->clear();
+    m_previewCancelled->store(true);
+    m_previewPath.clear();
+    m_preview.reset();
+    ui->widgetPreview->clear();
 }
 
 void MainWindow::slot_about()
@@ -128,14 +237,23 @@ void MainWindow::slot_start()
         return;
     }
 
-    int item_count = ui->listWidgetTaskList->count();
+    if (!m_scanners.isEmpty())
+    {
+        QMessageBox::warning(this, QApplication::applicationName(), "Please wait for the folder scan to complete!");
+        return;
+    }
+
+    int item_count = m_model->rowCount();
     if (item_count == 0)
     {
         return;
     }
 
     m_workFinished = 0;
+    m_workRunning = 0;
+    m_nextTask = 0;
     m_workTotal = item_count;
+    m_model->resetStatus();
 
     ui->progressBar->setMinimum(0);
     ui->progressBar->setMaximum(item_count);
@@ -150,48 +268,187 @@ void MainWindow::slot_start()
     }
 #endif
 
-    setProcessing(true);
+    m_outputDir = ui->lineEditOutputDir->text();
+    m_threshold = ui->lineEditThreshold->text().toDouble();
+    m_minLength = ui->lineEditMinLen->text().toULongLong();
+    m_minInterval = ui->lineEditMinInterval->text().toULongLong();
+    m_hopSize = ui->lineEditHopSize->text().toULongLong();
+    m_maxSilKept = ui->lineEditMaxSilence->text().toULongLong();
+    m_transform = ClipTransform();
+    m_transform.gain_mode = static_cast<GainMode>(ui->comboBoxNormalize->currentIndex());
+    m_transform.target_db = ui->lineEditTargetLevel->text().toDouble();
+    m_transform.target_sr = ui->lineEditOutputRate->text().toInt();
+    m_transform.quality = ui->comboBoxResampleQuality->currentIndex();
+
+    openJournal();
     for (int i = 0; i < item_count; i++)
     {
-        auto item = ui->listWidgetTaskList->item(i);
-        auto path = item->data(Qt::ItemDataRole::UserRole + 1).toString();
+        if (m_skipped[i])
+        {
+            m_model->setStatus(i, TaskStatus::Finished);
+            m_workFinished++;
+        }
+    }
+
+    setProcessing(true);
+    submitTasks();
+    m_statusTimer->start();
+    if (m_workFinished == m_workTotal)
+    {
+        m_statusTimer->stop();
+        slot_updateStatus();
+        slot_threadFinished();
+    }
+}
+
+static std::filesystem::path toPath(const QString &path)
+{
+#ifdef Q_OS_WIN
+    return std::filesystem::absolute(path.toStdWString());
+#else
+    return std::filesystem::absolute(path.toStdString());
+#endif
+}
+
+static QString journalPath()
+{
+    QDir dir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation));
+    dir.mkpath(".");
+    return dir.filePath("journal.txt");
+}
+
+void MainWindow::openJournal()
+{
+    /*
+     * The journal is removed when a run completes, so finding one means the last run was cut
+     * short. Its finished inputs can be skipped if the settings are the same, and the partial
+     * clips of the inputs it was slicing are removed either way.
+     */
+    int item_count = m_model->rowCount();
+    m_skipped = QVector<bool>(item_count, false);
+    m_journal.reset();
+
+    QStringList settings = {m_outputDir, QString::number(m_threshold), QString::number(m_minLength),
+                            QString::number(m_minInterval), QString::number(m_hopSize), QString::number(m_maxSilKept),
+                            QString::number((int)m_transform.gain_mode), QString::number(m_transform.target_db),
+                            QString::number(m_transform.target_sr), QString::number(m_transform.quality)};
+    m_paramsHash = hash_string(settings.join('\n').toStdString());
+
+    QString path = journalPath();
+    try
+    {
+        if (QFile::exists(path))
+        {
+            auto previous = std::make_unique<Journal>(toPath(path), true);
+            int finished = 0;
+            std::set<std::filesystem::path> outDirs;
+            for (int i = 0; i < item_count; i++)
+            {
+                auto input = toPath(m_model->path(i));
+                m_skipped[i] = previous->finished(input, m_paramsHash);
+                finished += m_skipped[i] ? 1 : 0;
+                outDirs.insert(m_outputDir.isEmpty() ? input.parent_path() : toPath(m_outputDir));
+            }
+            for (const auto &dir : outDirs)
+            {
+                remove_partial_outputs(dir);
+            }
+            if (finished > 0 && QMessageBox::question(
+                    this, QApplication::applicationName(),
+                    QString("%1 of these files were already sliced by a run that did not complete. Skip them?").arg(finished))
+                    == QMessageBox::Yes)
+            {
+                m_journal = std::move(previous);
+                return;
+            }
+            m_skipped.fill(false);
+        }
+        m_journal = std::make_unique<Journal>(toPath(path), false);
+    }
+    catch (const std::runtime_error &)
+    {
+        // Slicing works without a journal, it just cannot be resumed.
+        m_skipped.fill(false);
+        m_journal.reset();
+    }
+}
+
+void MainWindow::submitTasks()
+{
+    // Only as many tasks as there are pool threads exist at a time; the next one is
+    // created when a running task reports back.
+    while (m_workRunning < m_threadpool->maxThreadCount() && m_nextTask < m_workTotal)
+    {
+        int index = m_nextTask++;
+        if (m_skipped[index])
+        {
+            continue;
+        }
         auto runnable = new WorkThread(
-                path,
-                ui->lineEditOutputDir->text(),
-                ui->lineEditThreshold->text().toDouble(),
-                ui->lineEditMinLen->text().toULongLong(),
-                ui->lineEditMinInterval->text().toULongLong(),
-                ui->lineEditHopSize->text().toULongLong(),
-                ui->lineEditMaxSilence->text().toULongLong());
-        connect(runnable, SIGNAL(oneFinished()),
-                this, SLOT(slot_oneFinished()));
-        connect(runnable, SIGNAL(oneError(const QString &)),
-                this, SLOT(slot_oneError(const QString &)));
+                index,
+                m_model->path(index),
+                m_outputDir,
+                m_threshold,
+                m_minLength,
+                m_minInterval,
+                m_hopSize,
+                m_maxSilKept,
+                m_transform);
+        connect(runnable, SIGNAL(oneFinished(int, const QStringList &)),
+                this, SLOT(slot_oneFinished(int, const QStringList &)));
+        connect(runnable, SIGNAL(oneError(int, const QString &)),
+                this, SLOT(slot_oneError(int, const QString &)));
+        m_model->setStatus(index, TaskStatus::Running);
+        m_workRunning++;
         m_threadpool->start(runnable);
     }
 }
 
-void MainWindow::slot_oneFinished()
+void MainWindow::slot_oneFinished(int index, const QStringList &outputs)
 {
-    m_workFinished++;
-    ui->progressBar->setValue(m_workFinished);
-#ifdef Q_OS_WIN
-    if (m_pTaskbarList3)
+    if (m_journal)
     {
-        m_pTaskbarList3->SetProgressState((HWND)this->winId(), TBPF_NORMAL);
-        m_pTaskbarList3->SetProgressValue((HWND)this->winId(), (ULONGLONG)m_workFinished, (ULONGLONG)m_workTotal);
+        std::vector<std::filesystem::path> outputPaths;
+        for (const auto &output : outputs)
+        {
+            outputPaths.push_back(toPath(output));
+        }
+        try
+        {
+            m_journal->record(toPath(m_model->path(index)), m_paramsHash, outputPaths);
+        }
+        catch (const std::runtime_error &)
+        {
+            m_journal.reset();
+        }
     }
-#endif
+    m_model->setStatus(index, TaskStatus::Finished);
+    taskDone();
+}
+
+void MainWindow::slot_oneError(int index, const QString& errmsg)
+{
+    m_model->setStatus(index, TaskStatus::Failed, errmsg);
+    taskDone();
+}
+
+void MainWindow::taskDone()
+{
+    m_workFinished++;
+    m_workRunning--;
+    submitTasks();
 
     if (m_workFinished == m_workTotal)
     {
+        m_statusTimer->stop();
+        slot_updateStatus();
         slot_threadFinished();
     }
 }
 
-void MainWindow::slot_oneError(const QString& errmsg)
+void MainWindow::slot_updateStatus()
 {
-    m_workFinished++;
+    m_model->flush();
     ui->progressBar->setValue(m_workFinished);
 #ifdef Q_OS_WIN
     if (m_pTaskbarList3)
@@ -200,16 +457,16 @@ void MainWindow::slot_oneError(const QString& errmsg)
         m_pTaskbarList3->SetProgressValue((HWND)this->winId(), (ULONGLONG)m_workFinished, (ULONGLONG)m_workTotal);
     }
 #endif
-    // QMessageBox::critical(this, "Error", errmsg);
-
-    if (m_workFinished == m_workTotal)
-    {
-        slot_threadFinished();
-    }
 }
 
 void MainWindow::slot_threadFinished()
 {
+    // The run is complete, so there is nothing left to resume.
+    if (m_journal)
+    {
+        m_journal.reset();
+        QFile::remove(journalPath());
+    }
     setProcessing(false);
     m_workFinished = 0;
     m_workTotal = 0;
@@ -223,6 +480,117 @@ void MainWindow::slot_threadFinished()
             this, QApplication::applicationName(), "Slicing complete!");
 }
 
+void MainWindow::slot_normalizeChanged(int index)
+{
+    ui->lineEditTargetLevel->setText(QString::number(default_target_db(static_cast<GainMode>(index))));
+}
+
+void MainWindow::slot_previewSelected(const QModelIndex &current)
+{
+    if (current.isValid())
+    {
+        loadPreview(m_model->path(current.row()));
+    }
+}
+
+void MainWindow::loadPreview(const QString &path)
+{
+    // A newer selection supersedes any preview still being decoded.
+    m_previewCancelled->store(true);
+    m_previewCancelled = std::make_shared<std::atomic<bool>>(false);
+    m_previewTimer->stop();
+    if (path != m_previewPath)
+    {
+        m_previewPath = path;
+        m_preview.reset();
+        ui->widgetPreview->clear();
+    }
+    ui->widgetPreview->setMessage("Loading...");
+
+    auto loader = new PreviewLoader(path, ui->lineEditHopSize->text().toULongLong(),
+                                    ui->lineEditMinInterval->text().toULongLong(), m_previewCancelled);
+    connect(loader, SIGNAL(previewLoaded(PreviewDataPtr)),
+            this, SLOT(slot_previewLoaded(PreviewDataPtr)));
+    connect(loader, SIGNAL(previewFailed(const QString &, const QString &)),
+            this, SLOT(slot_previewFailed(const QString &, const QString &)));
+    QThreadPool::globalInstance()->start(loader);
+}
+
+void MainWindow::slot_previewLoaded(PreviewDataPtr data)
+{
+    if (data->path != m_previewPath)
+    {
+        return;
+    }
+    m_preview = std::move(data);
+    ui->widgetPreview->setData(m_preview);
+    updatePreviewSlices();
+}
+
+void MainWindow::slot_previewFailed(const QString &path, const QString &errmsg)
+{
+    if (path == m_previewPath)
+    {
+        m_preview.reset();
+        ui->widgetPreview->clear();
+        ui->widgetPreview->setMessage(errmsg);
+    }
+}
+
+void MainWindow::slot_thresholdSliderMoved(int value)
+{
+    if (qRound(ui->lineEditThreshold->text().toDouble()) != value)
+    {
+        ui->lineEditThreshold->setText(QString::number(value));
+    }
+}
+
+void MainWindow::slot_previewSettingsChanged()
+{
+    double threshold = ui->lineEditThreshold->text().toDouble();
+    ui->horizontalSliderThreshold->blockSignals(true);
+    ui->horizontalSliderThreshold->setValue(qRound(threshold));
+    ui->horizontalSliderThreshold->blockSignals(false);
+    ui->widgetPreview->setThreshold(threshold);
+    updatePreviewSlices();
+}
+
+void MainWindow::slot_previewReload()
+{
+    if (!m_previewPath.isEmpty())
+    {
+        loadPreview(m_previewPath);
+    }
+}
+
+void MainWindow::updatePreviewSlices()
+{
+    if (!m_preview)
+    {
+        return;
+    }
+    uint64_t hop_size = ui->lineEditHopSize->text().toULongLong();
+    uint64_t min_interval = ui->lineEditMinInterval->text().toULongLong();
+    if ((hop_size != m_preview->hopSizeMs) || (min_interval != m_preview->minIntervalMs))
+    {
+        m_previewTimer->start();
+        return;
+    }
+
+    // Only the slicing decisions are redone here: O(hops), no decoding and no RMS.
+    try
+    {
+        Slicer slicer(m_preview->sampleRate, ui->lineEditThreshold->text().toDouble(),
+                      ui->lineEditMinLen->text().toULongLong(), min_interval, hop_size,
+                      ui->lineEditMaxSilence->text().toULongLong());
+        ui->widgetPreview->setChunks(slicer.slice_envelope(m_preview->rms, m_preview->frames));
+    }
+    catch (const std::invalid_argument &)
+    {
+        ui->widgetPreview->setChunks({});
+    }
+}
+
 void MainWindow::warningProcessNotFinished()
 {
     QMessageBox::warning(this, QApplication::applicationName(), "Please wait for slicing to complete!");
@@ -234,13 +602,19 @@ void MainWindow::setProcessing(bool processing)
     ui->pushButtonStart->setText(processing ? "Slicing..." : "Start");
     ui->pushButtonStart->setEnabled(enabled);
     ui->pushButtonAddFiles->setEnabled(enabled);
-    ui->listWidgetTaskList->setEnabled(enabled);
+    ui->pushButtonAddFolder->setEnabled(enabled);
+    ui->listViewTaskList->setEnabled(enabled);
     ui->pushButtonClearList->setEnabled(enabled);
     ui->lineEditThreshold->setEnabled(enabled);
+    ui->horizontalSliderThreshold->setEnabled(enabled);
     ui->lineEditMinLen->setEnabled(enabled);
     ui->lineEditMinInterval->setEnabled(enabled);
     ui->lineEditHopSize->setEnabled(enabled);
     ui->lineEditMaxSilence->setEnabled(enabled);
+    ui->comboBoxNormalize->setEnabled(enabled);
+    ui->lineEditTargetLevel->setEnabled(enabled);
+    ui->lineEditOutputRate->setEnabled(enabled);
+    ui->comboBoxResampleQuality->setEnabled(enabled);
     ui->lineEditOutputDir->setEnabled(enabled);
     ui->pushButtonBrowse->setEnabled(enabled);
     m_processing = processing;
@@ -258,7 +632,7 @@ void MainWindow::closeEvent(QCloseEvent *event)
 void MainWindow::dragEnterEvent(QDragEnterEvent *event)
 {
     auto urls = event->mimeData()->urls();
-    bool has_wav = false;
+    bool has_audio = false;
     for (const auto &url: urls)
     {
         if (!url.isLocalFile())
@@ -266,14 +640,13 @@ void MainWindow::dragEnterEvent(QDragEnterEvent *event)
             continue;
         }
         auto path = url.toLocalFile();
-        auto ext = QFileInfo(path).suffix();
-        if (ext.compare("wav", Qt::CaseInsensitive) == 0)
+        if (QFileInfo(path).isDir() || isAudioFile(path))
         {
-            has_wav = true;
+            has_audio = true;
             break;
         }
     }
-    if (has_wav)
+    if (has_audio)
     {
         event->accept();
     }
@@ -282,6 +655,8 @@ void MainWindow::dragEnterEvent(QDragEnterEvent *event)
 void MainWindow::dropEvent(QDropEvent *event)
 {
     auto urls = event->mimeData()->urls();
+    QStringList paths;
+    QStringList dirs;
     for (const auto &url: urls)
     {
         if (!url.isLocalFile())
@@ -289,15 +664,18 @@ void MainWindow::dropEvent(QDropEvent *event)
             continue;
         }
         auto path = url.toLocalFile();
-        auto ext = QFileInfo(path).suffix();
-        if (ext.compare("wav", Qt::CaseInsensitive) != 0)
+        if (QFileInfo(path).isDir())
         {
-            continue;
+            dirs.append(path);
         }
-
-        auto *item = new QListWidgetItem();
-        item->setText(QFileInfo(path).fileName());
-        item->setData(Qt::ItemDataRole::UserRole + 1, path);
-        ui->listWidgetTaskList->addItem(item);
+        else if (isAudioFile(path))
+        {
+            paths.append(path);
+        }
+    }
+    m_model->addPaths(paths);
+    if (!dirs.isEmpty())
+    {
+        scanDirectories(dirs);
     }
 }
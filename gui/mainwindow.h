@@ -4,11 +4,23 @@
 #include <QWidget>
 #include <QMainWindow>
 #include <QThreadPool>
+#include <QTimer>
 #include <QEvent>
 #include <QCloseEvent>
 #include <QDragEnterEvent>
 #include <QDropEvent>
 #include <QMimeData>
+#include <QSet>
+#include <QModelIndex>
+#include <QVector>
+
+#include <atomic>
+#include <memory>
+
+#include "tasklistmodel.h"
+#include "previewloader.h"
+#include "../transform.h"
+#include "../journal.h"
 
 #ifdef Q_OS_WIN
 #include <ShlObj.h>
@@ -35,12 +47,23 @@ public:
 public slots:
     void slot_browse_output_dir();
     void slot_add_audio_files();
+    void slot_add_folder();
+    void slot_filesFound(const QStringList &paths);
+    void slot_scanFinished();
     void slot_clear_audio_list();
     void slot_about();
     void slot_start();
-    void slot_oneFinished();
-    void slot_oneError(const QString &errmsg);
+    void slot_oneFinished(int index, const QStringList &outputs);
+    void slot_oneError(int index, const QString &errmsg);
     void slot_threadFinished();
+    void slot_updateStatus();
+    void slot_normalizeChanged(int index);
+    void slot_previewSelected(const QModelIndex &current);
+    void slot_previewLoaded(PreviewDataPtr data);
+    void slot_previewFailed(const QString &path, const QString &errmsg);
+    void slot_previewSettingsChanged();
+    void slot_previewReload();
+    void slot_thresholdSliderMoved(int value);
 
 private:
     Ui::MainWindow *ui;
@@ -48,10 +71,43 @@ private:
     bool m_processing;
     int m_workTotal;
     int m_workFinished;
+    int m_workRunning;
+    int m_nextTask;
     QThreadPool *m_threadpool;
+    TaskListModel *m_model;
+    QTimer *m_statusTimer;
+    QSet<QObject *> m_scanners;
+    std::shared_ptr<std::atomic<bool>> m_scanCancelled;
+
+    // The previewed file is decoded once; slices are recomputed from its envelope on every edit.
+    QString m_previewPath;
+    PreviewDataPtr m_preview;
+    std::shared_ptr<std::atomic<bool>> m_previewCancelled;
+    QTimer *m_previewTimer;
+
+    // Settings captured when slicing starts, used for every task submitted afterwards.
+    QString m_outputDir;
+    double m_threshold;
+    uint64_t m_minLength;
+    uint64_t m_minInterval;
+    uint64_t m_hopSize;
+    uint64_t m_maxSilKept;
+    ClipTransform m_transform;
+
+    // Inputs finished so far, kept until the whole run completes so a crashed run can be resumed.
+    std::unique_ptr<Journal> m_journal;
+    uint64_t m_paramsHash;
+    QVector<bool> m_skipped;
 
     void warningProcessNotFinished();
     void setProcessing(bool processing);
+    void submitTasks();
+    void scanDirectories(const QStringList &dirs);
+    void cancelScans();
+    void taskDone();
+    void openJournal();
+    void loadPreview(const QString &path);
+    void updatePreviewSlices();
 
 #ifdef Q_OS_WIN
     private:
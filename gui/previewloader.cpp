@@ -0,0 +1,84 @@
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <sndfile.hh>
+
+#if (defined(WIN32) || defined(_WIN32) || defined(__WIN32)) || (defined(UNICODE) || defined(_UNICODE))
+#define USE_WIDE_CHAR
+#endif
+
+#include "previewloader.h"
+#include "../slicer.h"
+
+static constexpr sf_count_t PREVIEW_BLOCK_FRAMES = 65536;
+
+PreviewLoader::PreviewLoader(QString path, uint64_t hop_size, uint64_t min_interval, std::shared_ptr<std::atomic<bool>> cancelled)
+        : m_path(std::move(path)),
+          m_hop_size(hop_size),
+          m_min_interval(min_interval),
+          m_cancelled(std::move(cancelled))
+{}
+
+void PreviewLoader::run()
+{
+    if (m_hop_size == 0)
+    {
+        emit previewFailed(m_path, "The hop size must be positive");
+        return;
+    }
+    try
+    {
+#ifdef USE_WIDE_CHAR
+        SndfileHandle handle(m_path.toStdWString().c_str());
+#else
+        SndfileHandle handle(m_path.toStdString().c_str());
+#endif
+        if (handle.error())
+        {
+            emit previewFailed(m_path, QString::fromUtf8(handle.strError()));
+            return;
+        }
+        int channels = handle.channels();
+        int sr = handle.samplerate();
+
+        // Only the window and hop of this slicer matter; they depend on nothing but these two values.
+        Slicer slicer(sr, -40.0, m_min_interval, m_min_interval, m_hop_size, m_hop_size);
+        RmsEnvelope envelope(slicer.get_win_size(), slicer.get_hop_size());
+
+        auto data = std::make_shared<PreviewData>();
+        data->path = m_path;
+        data->sampleRate = sr;
+        data->hopSizeMs = m_hop_size;
+        data->minIntervalMs = m_min_interval;
+
+        // The file is read block by block, so even long recordings never sit in memory at once.
+        std::vector<float> block(PREVIEW_BLOCK_FRAMES * channels);
+        sf_count_t frames_read;
+        while ((frames_read = handle.readf(block.data(), PREVIEW_BLOCK_FRAMES)) > 0)
+        {
+            if (m_cancelled->load(std::memory_order_relaxed))
+            {
+                return;
+            }
+            envelope.feed(block.data(), (uint64_t)frames_read, (unsigned int)channels);
+            data->pyramid.append(block.data(), (uint64_t)frames_read, (unsigned int)channels);
+        }
+        data->pyramid.finish();
+        data->frames = envelope.frames();
+        data->rms = envelope.finish();
+
+        if (!m_cancelled->load(std::memory_order_relaxed))
+        {
+            emit previewLoaded(std::move(data));
+        }
+    }
+    catch (const std::invalid_argument& err)
+    {
+        emit previewFailed(m_path, QString("Invalid argument: %1").arg(err.what()));
+    }
+    catch (const std::bad_alloc&)
+    {
+        emit previewFailed(m_path, "Out of memory");
+    }
+}
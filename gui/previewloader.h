@@ -0,0 +1,50 @@
+#ifndef AUDIO_SLICER_PREVIEWLOADER_H
+#define AUDIO_SLICER_PREVIEWLOADER_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <QMetaType>
+#include <QObject>
+#include <QRunnable>
+#include <QString>
+
+#include "waveformpyramid.h"
+
+// Everything the preview needs from one file, decoded once and shared read-only with the UI.
+struct PreviewData {
+    QString path;
+    int sampleRate = 0;
+    uint64_t frames = 0;
+    // Parameters the RMS envelope was computed with; slices can be recomputed from it as long
+    // as these do not change.
+    uint64_t hopSizeMs = 0;
+    uint64_t minIntervalMs = 0;
+    std::vector<double> rms;
+    WaveformPyramid pyramid;
+};
+
+using PreviewDataPtr = std::shared_ptr<const PreviewData>;
+Q_DECLARE_METATYPE(PreviewDataPtr)
+
+// Decodes a file block by block on a pool thread into a waveform pyramid and an RMS envelope.
+class PreviewLoader : public QObject, public QRunnable {
+Q_OBJECT
+public:
+    PreviewLoader(QString path, uint64_t hop_size, uint64_t min_interval, std::shared_ptr<std::atomic<bool>> cancelled);
+    void run() override;
+
+private:
+    QString m_path;
+    uint64_t m_hop_size;
+    uint64_t m_min_interval;
+    std::shared_ptr<std::atomic<bool>> m_cancelled;
+
+signals:
+    void previewLoaded(PreviewDataPtr data);
+    void previewFailed(const QString &path, const QString &errmsg);
+};
+
+
+#endif //AUDIO_SLICER_PREVIEWLOADER_H
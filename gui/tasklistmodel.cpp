@@ -0,0 +1,154 @@
+#include <algorithm>
+
+#include <QBrush>
+#include <QColor>
+
+#include "tasklistmodel.h"
+
+TaskListModel::TaskListModel(QObject *parent)
+        : QAbstractListModel(parent),
+          m_dirtyFirst(-1),
+          m_dirtyLast(-1)
+{}
+
+int TaskListModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+    {
+        return 0;
+    }
+    return (int)m_paths.size();
+}
+
+QVariant TaskListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= (int)m_paths.size())
+    {
+        return {};
+    }
+
+    int row = index.row();
+    const QString &path = m_paths[row];
+    switch (role)
+    {
+        case Qt::DisplayRole:
+        {
+            // Only the visible rows are asked for, so the file name is not stored separately.
+            QString name = path.mid(path.lastIndexOf('/') + 1);
+            switch (m_status[row])
+            {
+                case TaskStatus::Running:
+                    return name + " (slicing...)";
+                case TaskStatus::Finished:
+                    return name + " (done)";
+                case TaskStatus::Failed:
+                    return name + " (failed)";
+                default:
+                    return name;
+            }
+        }
+        case Qt::ToolTipRole:
+        {
+            auto it = m_errors.constFind(row);
+            return it == m_errors.constEnd() ? path : path + "\n" + it.value();
+        }
+        case Qt::ForegroundRole:
+            if (m_status[row] == TaskStatus::Failed)
+            {
+                return QBrush(QColor(Qt::red));
+            }
+            return {};
+        case PathRole:
+            return path;
+        default:
+            return {};
+    }
+}
+
+void TaskListModel::addPaths(const QStringList &paths)
+{
+    if (paths.isEmpty())
+    {
+        return;
+    }
+
+    int first = (int)m_paths.size();
+    beginInsertRows(QModelIndex(), first, first + (int)paths.size() - 1);
+    m_paths.reserve(m_paths.size() + paths.size());
+    m_status.reserve(m_status.size() + paths.size());
+    for (const QString &path : paths)
+    {
+        m_paths.push_back(path);
+        m_status.push_back(TaskStatus::Pending);
+    }
+    endInsertRows();
+}
+
+void TaskListModel::clear()
+{
+    beginResetModel();
+    m_paths.clear();
+    m_paths.shrink_to_fit();
+    m_status.clear();
+    m_status.shrink_to_fit();
+    m_errors.clear();
+    m_dirtyFirst = -1;
+    m_dirtyLast = -1;
+    endResetModel();
+}
+
+const QString &TaskListModel::path(int row) const
+{
+    return m_paths[row];
+}
+
+TaskStatus TaskListModel::status(int row) const
+{
+    return m_status[row];
+}
+
+void TaskListModel::setStatus(int row, TaskStatus status, const QString &message)
+{
+    m_status[row] = status;
+    if (message.isEmpty())
+    {
+        m_errors.remove(row);
+    }
+    else
+    {
+        m_errors.insert(row, message);
+    }
+
+    if (m_dirtyFirst < 0)
+    {
+        m_dirtyFirst = row;
+        m_dirtyLast = row;
+    }
+    else
+    {
+        m_dirtyFirst = std::min(m_dirtyFirst, row);
+        m_dirtyLast = std::max(m_dirtyLast, row);
+    }
+}
+
+void TaskListModel::resetStatus()
+{
+    beginResetModel();
+    std::fill(m_status.begin(), m_status.end(), TaskStatus::Pending);
+    m_errors.clear();
+    m_dirtyFirst = -1;
+    m_dirtyLast = -1;
+    endResetModel();
+}
+
+void TaskListModel::flush()
+{
+    if (m_dirtyFirst < 0)
+    {
+        return;
+    }
+
+    emit dataChanged(index(m_dirtyFirst), index(m_dirtyLast));
+    m_dirtyFirst = -1;
+    m_dirtyLast = -1;
+}
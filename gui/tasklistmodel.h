@@ -0,0 +1,51 @@
+#ifndef AUDIO_SLICER_TASKLISTMODEL_H
+#define AUDIO_SLICER_TASKLISTMODEL_H
+
+#include <vector>
+#include <cstdint>
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+enum class TaskStatus : uint8_t
+{
+    Pending,
+    Running,
+    Finished,
+    Failed
+};
+
+// Task list backed by a flat vector of paths, so that views only touch the rows they display.
+// Status changes are recorded without notifying views; flush() emits one dataChanged for
+// everything changed since the previous call and is meant to be driven by a timer.
+class TaskListModel : public QAbstractListModel {
+Q_OBJECT
+public:
+    static constexpr int PathRole = Qt::UserRole + 1;
+
+    explicit TaskListModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    void addPaths(const QStringList &paths);
+    void clear();
+
+    const QString &path(int row) const;
+    TaskStatus status(int row) const;
+    void setStatus(int row, TaskStatus status, const QString &message = QString());
+    void resetStatus();
+    void flush();
+
+private:
+    std::vector<QString> m_paths;
+    std::vector<TaskStatus> m_status;
+    QHash<int, QString> m_errors;
+    int m_dirtyFirst;
+    int m_dirtyLast;
+};
+
+
+#endif //AUDIO_SLICER_TASKLISTMODEL_H
@@ -11,18 +11,21 @@
 
 #include <QtCore/QVariant>
 #include <QtWidgets/QApplication>
+#include <QtWidgets/QComboBox>
 #include <QtWidgets/QFormLayout>
 #include <QtWidgets/QGroupBox>
 #include <QtWidgets/QHBoxLayout>
 #include <QtWidgets/QLabel>
 #include <QtWidgets/QLineEdit>
-#include <QtWidgets/QListWidget>
+#include <QtWidgets/QListView>
 #include <QtWidgets/QMainWindow>
 #include <QtWidgets/QProgressBar>
 #include <QtWidgets/QPushButton>
+#include <QtWidgets/QSlider>
 #include <QtWidgets/QSpacerItem>
 #include <QtWidgets/QVBoxLayout>
 #include <QtWidgets/QWidget>
+#include "waveformview.h"
 
 QT_BEGIN_NAMESPACE
 
@@ -33,11 +36,12 @@ public:
     QVBoxLayout *verticalLayout;
     QHBoxLayout *horizontalLayout_2;
     QPushButton *pushButtonAddFiles;
+    QPushButton *pushButtonAddFolder;
     QSpacerItem *horizontalSpacer;
     QHBoxLayout *horizontalLayout;
     QGroupBox *groupBox;
     QVBoxLayout *verticalLayout_2;
-    QListWidget *listWidgetTaskList;
+    QListView *listViewTaskList;
     QPushButton *pushButtonClearList;
     QGroupBox *groupBox_2;
     QVBoxLayout *verticalLayout_3;
@@ -52,11 +56,25 @@ public:
     QLineEdit *lineEditHopSize;
     QLabel *label_6;
     QLineEdit *lineEditMaxSilence;
+    QLabel *label_8;
+    QComboBox *comboBoxNormalize;
+    QLabel *label_9;
+    QLineEdit *lineEditTargetLevel;
+    QLabel *label_10;
+    QLineEdit *lineEditOutputRate;
+    QLabel *label_11;
+    QComboBox *comboBoxResampleQuality;
     QLabel *label_7;
     QHBoxLayout *horizontalLayout_4;
     QLineEdit *lineEditOutputDir;
     QPushButton *pushButtonBrowse;
     QSpacerItem *verticalSpacer;
+    QGroupBox *groupBox_3;
+    QVBoxLayout *verticalLayout_4;
+    WaveformView *widgetPreview;
+    QHBoxLayout *horizontalLayout_5;
+    QLabel *label_12;
+    QSlider *horizontalSliderThreshold;
     QHBoxLayout *horizontalLayout_3;
     QPushButton *pushButtonAbout;
     QProgressBar *progressBar;
@@ -66,7 +84,7 @@ public:
     {
         if (MainWindow->objectName().isEmpty())
             MainWindow->setObjectName(QString::fromUtf8("MainWindow"));
-        MainWindow->resize(768, 480);
+        MainWindow->resize(768, 680);
         QFont font;
         font.setFamily(QString::fromUtf8("Microsoft YaHei UI"));
         MainWindow->setFont(font);
@@ -87,6 +105,13 @@ public:
 
         horizontalLayout_2->addWidget(pushButtonAddFiles);
 
+        pushButtonAddFolder = new QPushButton(centralwidget);
+        pushButtonAddFolder->setObjectName(QString::fromUtf8("pushButtonAddFolder"));
+        sizePolicy.setHeightForWidth(pushButtonAddFolder->sizePolicy().hasHeightForWidth());
+        pushButtonAddFolder->setSizePolicy(sizePolicy);
+
+        horizontalLayout_2->addWidget(pushButtonAddFolder);
+
         horizontalSpacer = new QSpacerItem(40, 20, QSizePolicy::Expanding, QSizePolicy::Minimum);
 
         horizontalLayout_2->addItem(horizontalSpacer);
@@ -105,11 +130,12 @@ public:
         groupBox->setSizePolicy(sizePolicy1);
         verticalLayout_2 = new QVBoxLayout(groupBox);
         verticalLayout_2->setObjectName(QString::fromUtf8("verticalLayout_2"));
-        listWidgetTaskList = new QListWidget(groupBox);
-        listWidgetTaskList->setObjectName(QString::fromUtf8("listWidgetTaskList"));
-        listWidgetTaskList->setFrameShadow(QFrame::Plain);
+        listViewTaskList = new QListView(groupBox);
+        listViewTaskList->setObjectName(QString::fromUtf8("listViewTaskList"));
+        listViewTaskList->setFrameShadow(QFrame::Plain);
+        listViewTaskList->setUniformItemSizes(true);
 
-        verticalLayout_2->addWidget(listWidgetTaskList);
+        verticalLayout_2->addWidget(listViewTaskList);
 
         pushButtonClearList = new QPushButton(groupBox);
         pushButtonClearList->setObjectName(QString::fromUtf8("pushButtonClearList"));
@@ -182,6 +208,56 @@ public:
 
         formLayout->setWidget(4, QFormLayout::FieldRole, lineEditMaxSilence);
 
+        label_8 = new QLabel(groupBox_2);
+        label_8->setObjectName(QString::fromUtf8("label_8"));
+
+        formLayout->setWidget(5, QFormLayout::LabelRole, label_8);
+
+        comboBoxNormalize = new QComboBox(groupBox_2);
+        comboBoxNormalize->addItem(QString());
+        comboBoxNormalize->addItem(QString());
+        comboBoxNormalize->addItem(QString());
+        comboBoxNormalize->addItem(QString());
+        comboBoxNormalize->setObjectName(QString::fromUtf8("comboBoxNormalize"));
+
+        formLayout->setWidget(5, QFormLayout::FieldRole, comboBoxNormalize);
+
+        label_9 = new QLabel(groupBox_2);
+        label_9->setObjectName(QString::fromUtf8("label_9"));
+
+        formLayout->setWidget(6, QFormLayout::LabelRole, label_9);
+
+        lineEditTargetLevel = new QLineEdit(groupBox_2);
+        lineEditTargetLevel->setObjectName(QString::fromUtf8("lineEditTargetLevel"));
+        lineEditTargetLevel->setAlignment(Qt::AlignRight|Qt::AlignTrailing|Qt::AlignVCenter);
+
+        formLayout->setWidget(6, QFormLayout::FieldRole, lineEditTargetLevel);
+
+        label_10 = new QLabel(groupBox_2);
+        label_10->setObjectName(QString::fromUtf8("label_10"));
+
+        formLayout->setWidget(7, QFormLayout::LabelRole, label_10);
+
+        lineEditOutputRate = new QLineEdit(groupBox_2);
+        lineEditOutputRate->setObjectName(QString::fromUtf8("lineEditOutputRate"));
+        lineEditOutputRate->setAlignment(Qt::AlignRight|Qt::AlignTrailing|Qt::AlignVCenter);
+
+        formLayout->setWidget(7, QFormLayout::FieldRole, lineEditOutputRate);
+
+        label_11 = new QLabel(groupBox_2);
+        label_11->setObjectName(QString::fromUtf8("label_11"));
+
+        formLayout->setWidget(8, QFormLayout::LabelRole, label_11);
+
+        comboBoxResampleQuality = new QComboBox(groupBox_2);
+        comboBoxResampleQuality->addItem(QString());
+        comboBoxResampleQuality->addItem(QString());
+        comboBoxResampleQuality->addItem(QString());
+        comboBoxResampleQuality->addItem(QString());
+        comboBoxResampleQuality->setObjectName(QString::fromUtf8("comboBoxResampleQuality"));
+
+        formLayout->setWidget(8, QFormLayout::FieldRole, comboBoxResampleQuality);
+
 
         verticalLayout_3->addLayout(formLayout);
 
@@ -216,6 +292,42 @@ public:
 
         verticalLayout->addLayout(horizontalLayout);
 
+        groupBox_3 = new QGroupBox(centralwidget);
+        groupBox_3->setObjectName(QString::fromUtf8("groupBox_3"));
+        verticalLayout_4 = new QVBoxLayout(groupBox_3);
+        verticalLayout_4->setObjectName(QString::fromUtf8("verticalLayout_4"));
+        widgetPreview = new WaveformView(groupBox_3);
+        widgetPreview->setObjectName(QString::fromUtf8("widgetPreview"));
+        QSizePolicy sizePolicy2(QSizePolicy::Expanding, QSizePolicy::Expanding);
+        sizePolicy2.setHorizontalStretch(0);
+        sizePolicy2.setVerticalStretch(1);
+        sizePolicy2.setHeightForWidth(widgetPreview->sizePolicy().hasHeightForWidth());
+        widgetPreview->setSizePolicy(sizePolicy2);
+
+        verticalLayout_4->addWidget(widgetPreview);
+
+        horizontalLayout_5 = new QHBoxLayout();
+        horizontalLayout_5->setObjectName(QString::fromUtf8("horizontalLayout_5"));
+        label_12 = new QLabel(groupBox_3);
+        label_12->setObjectName(QString::fromUtf8("label_12"));
+
+        horizontalLayout_5->addWidget(label_12);
+
+        horizontalSliderThreshold = new QSlider(groupBox_3);
+        horizontalSliderThreshold->setObjectName(QString::fromUtf8("horizontalSliderThreshold"));
+        horizontalSliderThreshold->setMinimum(-80);
+        horizontalSliderThreshold->setMaximum(0);
+        horizontalSliderThreshold->setValue(-40);
+        horizontalSliderThreshold->setOrientation(Qt::Horizontal);
+
+        horizontalLayout_5->addWidget(horizontalSliderThreshold);
+
+
+        verticalLayout_4->addLayout(horizontalLayout_5);
+
+
+        verticalLayout->addWidget(groupBox_3);
+
         horizontalLayout_3 = new QHBoxLayout();
         horizontalLayout_3->setObjectName(QString::fromUtf8("horizontalLayout_3"));
         pushButtonAbout = new QPushButton(centralwidget);
@@ -241,6 +353,8 @@ public:
 
         retranslateUi(MainWindow);
 
+        comboBoxResampleQuality->setCurrentIndex(2);
+
         QMetaObject::connectSlotsByName(MainWindow);
     } // setupUi
 
@@ -248,6 +362,7 @@ public:
     {
         MainWindow->setWindowTitle(QCoreApplication::translate("MainWindow", "MainWindow", nullptr));
         pushButtonAddFiles->setText(QCoreApplication::translate("MainWindow", "Add Audio Files...", nullptr));
+        pushButtonAddFolder->setText(QCoreApplication::translate("MainWindow", "Add Folder...", nullptr));
         groupBox->setTitle(QCoreApplication::translate("MainWindow", "Task List", nullptr));
         pushButtonClearList->setText(QCoreApplication::translate("MainWindow", "Clear List", nullptr));
         groupBox_2->setTitle(QCoreApplication::translate("MainWindow", "Settings", nullptr));
@@ -261,9 +376,27 @@ public:
         lineEditHopSize->setText(QCoreApplication::translate("MainWindow", "10", nullptr));
         label_6->setText(QCoreApplication::translate("MainWindow", "Maximum Silence Length (ms)", nullptr));
         lineEditMaxSilence->setText(QCoreApplication::translate("MainWindow", "1000", nullptr));
+        label_8->setText(QCoreApplication::translate("MainWindow", "Normalize", nullptr));
+        comboBoxNormalize->setItemText(0, QCoreApplication::translate("MainWindow", "None", nullptr));
+        comboBoxNormalize->setItemText(1, QCoreApplication::translate("MainWindow", "Peak", nullptr));
+        comboBoxNormalize->setItemText(2, QCoreApplication::translate("MainWindow", "RMS", nullptr));
+        comboBoxNormalize->setItemText(3, QCoreApplication::translate("MainWindow", "Loudness (LUFS)", nullptr));
+
+        label_9->setText(QCoreApplication::translate("MainWindow", "Target Level (dB / LUFS)", nullptr));
+        lineEditTargetLevel->setText(QCoreApplication::translate("MainWindow", "-1", nullptr));
+        label_10->setText(QCoreApplication::translate("MainWindow", "Output Sample Rate (Hz, 0 = keep)", nullptr));
+        lineEditOutputRate->setText(QCoreApplication::translate("MainWindow", "0", nullptr));
+        label_11->setText(QCoreApplication::translate("MainWindow", "Resample Quality", nullptr));
+        comboBoxResampleQuality->setItemText(0, QCoreApplication::translate("MainWindow", "Fast", nullptr));
+        comboBoxResampleQuality->setItemText(1, QCoreApplication::translate("MainWindow", "Medium", nullptr));
+        comboBoxResampleQuality->setItemText(2, QCoreApplication::translate("MainWindow", "High", nullptr));
+        comboBoxResampleQuality->setItemText(3, QCoreApplication::translate("MainWindow", "Best", nullptr));
+
         label_7->setText(QCoreApplication::translate("MainWindow", "Output Directory (default to the same as the audio)", nullptr));
         lineEditOutputDir->setText(QString());
         pushButtonBrowse->setText(QCoreApplication::translate("MainWindow", "Browse...", nullptr));
+        groupBox_3->setTitle(QCoreApplication::translate("MainWindow", "Preview", nullptr));
+        label_12->setText(QCoreApplication::translate("MainWindow", "Threshold (dB)", nullptr));
         pushButtonAbout->setText(QCoreApplication::translate("MainWindow", "About", nullptr));
         pushButtonStart->setText(QCoreApplication::translate("MainWindow", "Start", nullptr));
     } // retranslateUi
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <cmath>
+
+#include "waveformpyramid.h"
+
+void WaveformSummary::merge(const WaveformSummary &other)
+{
+    if (other.frames == 0)
+    {
+        return;
+    }
+    if (frames == 0)
+    {
+        *this = other;
+        return;
+    }
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    energy += other.energy;
+    frames += other.frames;
+}
+
+double WaveformSummary::rms() const
+{
+    return (frames > 0) ? std::sqrt(energy / (double)frames) : 0.0;
+}
+
+WaveformPyramid::WaveformPyramid()
+        : m_levels(1),
+          m_frames(0)
+{}
+
+void WaveformPyramid::append(const float *waveform, uint64_t frames, unsigned int channels)
+{
+    auto &base = m_levels[0];
+    for (uint64_t i = 0; i < frames; i++)
+    {
+        float s = 0;
+        for (unsigned int j = 0; j < channels; j++)
+        {
+            s += waveform[i * channels + j] / (float)channels;
+        }
+        if (m_pending.frames == 0)
+        {
+            m_pending.min = s;
+            m_pending.max = s;
+        }
+        else
+        {
+            m_pending.min = std::min(m_pending.min, s);
+            m_pending.max = std::max(m_pending.max, s);
+        }
+        m_pending.energy += (double)s * s;
+        m_pending.frames++;
+        if (m_pending.frames == BASE_BLOCK)
+        {
+            base.push_back(m_pending);
+            m_pending = WaveformSummary();
+        }
+    }
+    m_frames += frames;
+}
+
+void WaveformPyramid::finish()
+{
+    if (m_pending.frames > 0)
+    {
+        m_levels[0].push_back(m_pending);
+        m_pending = WaveformSummary();
+    }
+    m_levels.resize(1);
+    while (m_levels.back().size() > 1)
+    {
+        const auto &below = m_levels.back();
+        std::vector<WaveformSummary> level((below.size() + FANOUT - 1) / FANOUT);
+        for (size_t i = 0; i < below.size(); i++)
+        {
+            level[i / FANOUT].merge(below[i]);
+        }
+        m_levels.push_back(std::move(level));
+    }
+}
+
+uint64_t WaveformPyramid::frames() const
+{
+    return m_frames;
+}
+
+std::vector<WaveformSummary> WaveformPyramid::render(double begin, double end, int pixels) const
+{
+    std::vector<WaveformSummary> result(std::max(pixels, 0));
+    if (pixels <= 0 || end <= begin || m_levels[0].empty())
+    {
+        return result;
+    }
+
+    // The coarsest level whose blocks are no wider than a pixel; each pixel then merges
+    // at most FANOUT + 2 blocks.
+    double frames_per_pixel = (end - begin) / pixels;
+    size_t level = 0;
+    double block = (double)BASE_BLOCK;
+    while (level + 1 < m_levels.size() && block * FANOUT <= frames_per_pixel)
+    {
+        level++;
+        block *= FANOUT;
+    }
+    const auto &blocks = m_levels[level];
+
+    for (int p = 0; p < pixels; p++)
+    {
+        double a = std::max(begin + p * frames_per_pixel, 0.0);
+        double b = std::min(begin + (p + 1) * frames_per_pixel, (double)m_frames);
+        if (a >= b)
+        {
+            continue;
+        }
+        auto first = (size_t)(a / block);
+        auto last = std::min(std::max(first + 1, (size_t)std::ceil(b / block)), blocks.size());
+        for (size_t i = first; i < last; i++)
+        {
+            result[p].merge(blocks[i]);
+        }
+    }
+    return result;
+}
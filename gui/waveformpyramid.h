@@ -0,0 +1,44 @@
+#ifndef AUDIO_SLICER_WAVEFORMPYRAMID_H
+#define AUDIO_SLICER_WAVEFORMPYRAMID_H
+
+#include <cstdint>
+#include <vector>
+
+// Extremes and energy of the mono downmix over a range of frames.
+struct WaveformSummary {
+    float min = 0;
+    float max = 0;
+    double energy = 0;
+    uint64_t frames = 0;
+
+    void merge(const WaveformSummary &other);
+    double rms() const;
+};
+
+/*
+ * Min/max/energy mipmap of a waveform, built once while the file is decoded. Level 0 summarizes
+ * blocks of BASE_BLOCK frames and every further level merges FANOUT blocks of the level below,
+ * so any zoom factor is served from a level whose blocks are at most FANOUT times finer than a
+ * pixel, and rendering costs O(pixels) whatever the length of the file.
+ */
+class WaveformPyramid {
+public:
+    static constexpr uint64_t BASE_BLOCK = 64;
+    static constexpr uint64_t FANOUT = 4;
+
+    WaveformPyramid();
+    void append(const float *waveform, uint64_t frames, unsigned int channels);
+    // Summarizes the last partial block and builds the upper levels.
+    void finish();
+    uint64_t frames() const;
+    // One summary per pixel of the frames [begin, end); empty pixels past the end have no frames.
+    std::vector<WaveformSummary> render(double begin, double end, int pixels) const;
+
+private:
+    std::vector<std::vector<WaveformSummary>> m_levels;
+    WaveformSummary m_pending;
+    uint64_t m_frames;
+};
+
+
+#endif //AUDIO_SLICER_WAVEFORMPYRAMID_H
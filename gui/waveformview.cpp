@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include <QPainter>
+
+#include "waveformview.h"
+
+// Lowest level drawn, in dB; quieter hops sit on the center line.
+static constexpr double VIEW_MIN_DB = -80.0;
+// Closest zoom: this many frames per pixel.
+static constexpr double VIEW_MIN_FRAMES_PER_PIXEL = 0.25;
+
+WaveformView::WaveformView(QWidget *parent)
+        : QWidget(parent),
+          m_threshold(-40.0),
+          m_viewBegin(0),
+          m_viewFrames(0),
+          m_dragX(0),
+          m_dragBegin(0)
+{
+    setMinimumHeight(120);
+    setMouseTracking(false);
+}
+
+void WaveformView::setData(PreviewDataPtr data)
+{
+    // A file decoded again with other settings keeps the current zoom.
+    bool same_file = m_data && data && (m_data->path == data->path) && (m_data->frames == data->frames);
+    m_data = std::move(data);
+    m_chunks.clear();
+    m_message.clear();
+    if (!same_file)
+    {
+        m_viewBegin = 0;
+        m_viewFrames = m_data ? (double)m_data->frames : 0;
+    }
+    update();
+}
+
+void WaveformView::setChunks(std::vector<std::tuple<uint64_t, uint64_t>> chunks)
+{
+    m_chunks = std::move(chunks);
+    update();
+}
+
+void WaveformView::setThreshold(double threshold_db)
+{
+    m_threshold = threshold_db;
+    update();
+}
+
+void WaveformView::setMessage(const QString &message)
+{
+    m_message = message;
+    update();
+}
+
+void WaveformView::clear()
+{
+    setData(nullptr);
+}
+
+void WaveformView::clampView()
+{
+    if (!m_data)
+    {
+        return;
+    }
+    auto total = (double)m_data->frames;
+    double min_frames = std::min(total, std::max(1, width()) * VIEW_MIN_FRAMES_PER_PIXEL);
+    m_viewFrames = std::clamp(m_viewFrames, min_frames, total);
+    m_viewBegin = std::clamp(m_viewBegin, 0.0, total - m_viewFrames);
+}
+
+double WaveformView::frameAt(double x) const
+{
+    return m_viewBegin + x * m_viewFrames / std::max(1, width());
+}
+
+double WaveformView::xAt(double frame) const
+{
+    return (frame - m_viewBegin) * std::max(1, width()) / std::max(m_viewFrames, 1.0);
+}
+
+double WaveformView::levelY(double amplitude, bool upper) const
+{
+    double half = height() / 2.0;
+    double db = std::clamp(20.0 * std::log10(std::max(amplitude, 1e-10)), VIEW_MIN_DB, 0.0);
+    double offset = (db - VIEW_MIN_DB) / -VIEW_MIN_DB * (half - 1);
+    return upper ? half - offset : half + offset;
+}
+
+void WaveformView::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().base());
+
+    if (!m_data || m_data->frames == 0)
+    {
+        painter.setPen(palette().color(QPalette::PlaceholderText));
+        painter.drawText(rect(), Qt::AlignCenter, m_message.isEmpty() ? "Select a file to preview its slices" : m_message);
+        return;
+    }
+
+    int w = width();
+    int h = height();
+    double view_end = m_viewBegin + m_viewFrames;
+
+    // Clips are sorted, so only those overlapping the view are visited.
+    auto first = std::lower_bound(m_chunks.begin(), m_chunks.end(), m_viewBegin,
+                                  [](const std::tuple<uint64_t, uint64_t> &chunk, double frame)
+                                  { return (double)std::get<1>(chunk) <= frame; });
+    QColor clip_fill(76, 175, 80, 48);
+    QColor clip_edge(56, 142, 60);
+    for (auto it = first; it != m_chunks.end() && (double)std::get<0>(*it) < view_end; ++it)
+    {
+        double x0 = std::max(xAt((double)std::get<0>(*it)), -1.0);
+        double x1 = std::min(xAt((double)std::get<1>(*it)), (double)w + 1);
+        painter.fillRect(QRectF(x0, 0, x1 - x0, h), clip_fill);
+        painter.setPen(clip_edge);
+        painter.drawLine(QPointF(x0, 0), QPointF(x0, h));
+        painter.drawLine(QPointF(x1, 0), QPointF(x1, h));
+    }
+
+    auto columns = m_data->pyramid.render(m_viewBegin, view_end, w);
+    QColor peak_color = palette().color(QPalette::Highlight);
+    QColor rms_color = peak_color.darker(160);
+    for (int x = 0; x < w; x++)
+    {
+        const auto &column = columns[x];
+        if (column.frames == 0)
+        {
+            continue;
+        }
+        double peak = std::max(std::fabs(column.min), std::fabs(column.max));
+        painter.setPen(peak_color);
+        painter.drawLine(QPointF(x + 0.5, levelY(peak, true)), QPointF(x + 0.5, levelY(peak, false)));
+        double rms = column.rms();
+        painter.setPen(rms_color);
+        painter.drawLine(QPointF(x + 0.5, levelY(rms, true)), QPointF(x + 0.5, levelY(rms, false)));
+    }
+
+    double threshold = std::pow(10.0, m_threshold / 20.0);
+    QPen threshold_pen(QColor(229, 57, 53));
+    threshold_pen.setStyle(Qt::DashLine);
+    painter.setPen(threshold_pen);
+    painter.drawLine(QPointF(0, levelY(threshold, true)), QPointF(w, levelY(threshold, true)));
+    painter.drawLine(QPointF(0, levelY(threshold, false)), QPointF(w, levelY(threshold, false)));
+
+    painter.setPen(palette().color(QPalette::Text));
+    double sr = std::max(m_data->sampleRate, 1);
+    painter.drawText(rect().adjusted(4, 2, -4, -2), Qt::AlignLeft | Qt::AlignTop,
+                     QString("%1 s").arg(m_viewBegin / sr, 0, 'f', 3));
+    painter.drawText(rect().adjusted(4, 2, -4, -2), Qt::AlignRight | Qt::AlignTop,
+                     QString("%1 s").arg(view_end / sr, 0, 'f', 3));
+    painter.drawText(rect().adjusted(4, 2, -4, -2), Qt::AlignLeft | Qt::AlignBottom,
+                     QString("%1 clips").arg(m_chunks.size()));
+}
+
+void WaveformView::wheelEvent(QWheelEvent *event)
+{
+    if (!m_data)
+    {
+        return;
+    }
+    double steps = event->angleDelta().y() / 120.0;
+    double x = event->position().x();
+    double anchor = frameAt(x);
+    m_viewFrames *= std::pow(0.8, steps);
+    clampView();
+    m_viewBegin = anchor - x * m_viewFrames / std::max(1, width());
+    clampView();
+    update();
+    event->accept();
+}
+
+void WaveformView::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton)
+    {
+        m_dragX = event->x();
+        m_dragBegin = m_viewBegin;
+    }
+}
+
+void WaveformView::mouseMoveEvent(QMouseEvent *event)
+{
+    if (m_data && (event->buttons() & Qt::LeftButton))
+    {
+        m_viewBegin = m_dragBegin - (event->x() - m_dragX) * m_viewFrames / std::max(1, width());
+        clampView();
+        update();
+    }
+}
+
+void WaveformView::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    Q_UNUSED(event);
+    if (m_data)
+    {
+        m_viewBegin = 0;
+        m_viewFrames = (double)m_data->frames;
+        update();
+    }
+}
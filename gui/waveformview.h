@@ -0,0 +1,57 @@
+#ifndef AUDIO_SLICER_WAVEFORMVIEW_H
+#define AUDIO_SLICER_WAVEFORMVIEW_H
+
+#include <tuple>
+#include <vector>
+
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QWheelEvent>
+#include <QWidget>
+
+#include "previewloader.h"
+
+/*
+ * Waveform of one file with its RMS level, the silence threshold and the clips the current
+ * settings would produce. Levels are drawn on a dB scale mirrored around the center line.
+ * The wheel zooms around the cursor and dragging pans; every repaint reads one summary per
+ * pixel from the pyramid, so it costs the same at any zoom.
+ */
+class WaveformView : public QWidget {
+Q_OBJECT
+public:
+    explicit WaveformView(QWidget *parent = nullptr);
+
+    // Keeps the zoom if data is the same file decoded again.
+    void setData(PreviewDataPtr data);
+    void setChunks(std::vector<std::tuple<uint64_t, uint64_t>> chunks);
+    void setThreshold(double threshold_db);
+    void setMessage(const QString &message);
+    void clear();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+
+private:
+    PreviewDataPtr m_data;
+    std::vector<std::tuple<uint64_t, uint64_t>> m_chunks;
+    double m_threshold;
+    QString m_message;
+    // Visible range in frames; fractional so that zooming keeps the frame under the cursor fixed.
+    double m_viewBegin;
+    double m_viewFrames;
+    int m_dragX;
+    double m_dragBegin;
+
+    void clampView();
+    double frameAt(double x) const;
+    double xAt(double frame) const;
+    double levelY(double amplitude, bool upper) const;
+};
+
+
+#endif //AUDIO_SLICER_WAVEFORMVIEW_H
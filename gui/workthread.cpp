@@ -4,6 +4,8 @@
 #include <string>
 #include <filesystem>
 #include <sstream>
+#include <memory>
+#include <thread>
 
 #include <sndfile.hh>
 
@@ -15,26 +17,36 @@
 
 #include "workthread.h"
 #include "../slicer.h"
+#include "../bufferpool.h"
+#include "../wavcopy.h"
+#include "../decoder.h"
+#include "../journal.h"
+#include "../clipoutput.h"
 
 WorkThread::WorkThread(
+        int index,
         QString filename,
         QString out_path,
         double threshold,
         uint64_t min_length,
         uint64_t min_interval,
         uint64_t hop_size,
-        uint64_t max_sil_kept)
-        : m_filename(std::move(filename)),
+        uint64_t max_sil_kept,
+        const ClipTransform &transform)
+        : m_index(index),
+          m_filename(std::move(filename)),
           m_out_path(std::move(out_path)),
           m_threshold(threshold),
           m_min_length(min_length),
           m_min_interval(min_interval),
           m_hop_size(hop_size),
-          m_max_sil_kept(max_sil_kept)
+          m_max_sil_kept(max_sil_kept),
+          m_transform(transform)
 {}
 
 void WorkThread::run()
 {
+    QStringList outputs;
     try
     {
 #ifdef USE_WIDE_CHAR
@@ -57,25 +69,41 @@ void WorkThread::run()
         int format = handle.format();
         auto frames = handle.frames();
 
-        auto total_size = frames * channels;
-        std::vector<float> audio = std::vector<float>(total_size);
+        auto audio = BufferPool::shared().acquire((uint64_t)(frames * channels));
 
-        auto items_read = handle.read(audio.data(), total_size);
+        // Tasks run one at a time, so every core can help decoding.
+        auto items_read = decode_frames(handle, path, audio.data(), frames, std::thread::hardware_concurrency()) * channels;
 
-        if (items_read == 0)
+        if (items_read <= 0)
         {
-            emit oneError(QString("Zero items read: %1").arg(m_filename));
+            emit oneError(m_index, QString("Zero items read: %1").arg(m_filename));
             return;
         }
+        // Pooled buffers are not cleared, so a truncated file is sliced only as far as it was decoded.
+        auto total_size = items_read;
 
         Slicer slicer(sr, m_threshold, m_min_length, m_min_interval, m_hop_size, m_max_sil_kept);
-        auto chunks = slicer.slice(audio, (unsigned int)channels);
+        auto chunks = slicer.slice(audio.data(), (uint64_t)total_size, (unsigned int)channels);
 
         if (!std::filesystem::exists(out))
         {
             std::filesystem::create_directories(out);
         }
 
+        // Normalization and resampling run here on the pool thread, as each clip is written.
+        std::unique_ptr<ClipProcessor> processor;
+        if (m_transform.enabled())
+        {
+            processor = std::make_unique<ClipProcessor>(m_transform, sr, (unsigned int)channels);
+        }
+
+        // Clips of an uncompressed WAV input keep its encoding, so their bytes can be copied as they are.
+        WavLayout wav_layout {};
+        bool copy_wav = !processor && ((format & SF_FORMAT_TYPEMASK) == SF_FORMAT_WAV) && read_wav_layout(path, wav_layout) &&
+                (wav_layout.channels == channels) && (wav_layout.data_size / wav_layout.block_align == (uint64_t)(total_size / channels));
+
+        // Clips are encoded into a buffer kept by this pool thread and written at once.
+        ClipOutput &clip_output = ClipOutput::for_thread();
         int idx = 0;
         for (auto chunk : chunks)
         {
@@ -97,23 +125,71 @@ void WorkThread::run()
             std::filesystem::path out_file_path = out / ss.str();
             std::string out_file_path_str = out_file_path.string();
 #endif
-            SndfileHandle wf = SndfileHandle(out_file_path_str.c_str(), SFM_WRITE, format, channels, sr);
-            wf.write(audio.data() + begin_frame, frame_count);
+            // Written under a partial name and renamed once complete, so no crash leaves a truncated clip behind.
+            std::filesystem::path part_path = partial_path(out_file_path);
+            if (processor)
+            {
+                const auto &processed = processor->process(audio.data() + begin_frame, (uint64_t)(frame_count / channels));
+                if (!clip_output.write(part_path, format, channels, processor->output_rate(), processed.data(),
+                                       processed.size() / channels))
+                {
+#ifdef USE_WIDE_CHAR
+                    SndfileHandle wf = SndfileHandle(part_path.wstring().c_str(), SFM_WRITE, format, channels, processor->output_rate());
+#else
+                    SndfileHandle wf = SndfileHandle(part_path.string().c_str(), SFM_WRITE, format, channels, processor->output_rate());
+#endif
+                    wf.write(processed.data(), (sf_count_t)processed.size());
+                }
+            }
+            else if ((!copy_wav || !copy_wav_clip(path, wav_layout, std::get<0>(chunk), std::get<1>(chunk), part_path)) &&
+                     !clip_output.write(part_path, format, channels, sr, audio.data() + begin_frame, (uint64_t)(frame_count / channels)))
+            {
+#ifdef USE_WIDE_CHAR
+                SndfileHandle wf = SndfileHandle(part_path.wstring().c_str(), SFM_WRITE, format, channels, sr);
+#else
+                SndfileHandle wf = SndfileHandle(part_path.string().c_str(), SFM_WRITE, format, channels, sr);
+#endif
+                wf.write(audio.data() + begin_frame, frame_count);
+            }
+            commit_output(out_file_path);
+#ifdef USE_WIDE_CHAR
+            outputs.append(QString::fromStdWString(out_file_path_str));
+#else
+            outputs.append(QString::fromStdString(out_file_path_str));
+#endif
             idx++;
         }
     }
     catch (const std::invalid_argument& err)
     {
         QString errmsg = QString("Invalid argument: %1").arg(err.what());
-        emit oneError(errmsg);
+        emit oneError(m_index, errmsg);
         return;
     }
     catch (const std::filesystem::filesystem_error& err)
     {
         QString errmsg = QString("Filesystem error: %1").arg(err.what());
-        emit oneError(errmsg);
+        emit oneError(m_index, errmsg);
+        return;
+    }
+    catch (const std::runtime_error& err)
+    {
+        QString errmsg = QString("I/O error: %1").arg(err.what());
+        emit oneError(m_index, errmsg);
+        return;
+    }
+    // Every task must report back, or the tasks queued behind it are never submitted.
+    catch (const std::exception& err)
+    {
+        QString errmsg = QString("Error: %1").arg(err.what());
+        emit oneError(m_index, errmsg);
+        return;
+    }
+    catch (...)
+    {
+        emit oneError(m_index, QString("Unknown error"));
         return;
     }
 
-    emit oneFinished();
+    emit oneFinished(m_index, outputs);
 }
@@ -7,19 +7,24 @@
 #include <QString>
 #include <QStringList>
 
+#include "../transform.h"
+
 class WorkThread : public QObject, public QRunnable {
 Q_OBJECT
 public:
-    WorkThread(QString filename,
+    WorkThread(int index,
+               QString filename,
                QString out_path,
                double threshold,
                uint64_t min_length,
                uint64_t min_interval,
                uint64_t hop_size,
-               uint64_t max_sil_kept);
+               uint64_t max_sil_kept,
+               const ClipTransform &transform);
     void run() override;
 
 private:
+    int m_index;
     QString m_filename;
     QString m_out_path;
     double m_threshold;
@@ -27,10 +32,11 @@ private:
     uint64_t m_min_interval;
     uint64_t m_hop_size;
     uint64_t m_max_sil_kept;
+    ClipTransform m_transform;
 
 signals:
-    void oneFinished();
-    void oneError(const QString &errmsg);
+    void oneFinished(int index, const QStringList &outputs);
+    void oneError(int index, const QString &errmsg);
 };
 
 
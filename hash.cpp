@@ -0,0 +1,149 @@
+#include <cstring>
+#include <algorithm>
+
+#include "hash.h"
+
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char *p)
+{
+    // xxHash is defined on little endian words.
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--)
+    {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    acc *= PRIME64_1;
+    return acc;
+}
+
+static inline uint64_t merge_round64(uint64_t acc, uint64_t val)
+{
+    acc ^= round64(0, val);
+    acc = acc * PRIME64_1 + PRIME64_4;
+    return acc;
+}
+
+Hash64::Hash64(uint64_t seed)
+        : seed(seed),
+          v{seed + PRIME64_1 + PRIME64_2, seed + PRIME64_2, seed, seed - PRIME64_1},
+          total_length(0),
+          buffer(),
+          buffer_size(0)
+{}
+
+void Hash64::update(const void *data, size_t size)
+{
+    auto p = static_cast<const unsigned char *>(data);
+    auto end = p + size;
+    this->total_length += size;
+
+    // Complete a stripe left over from the previous call first.
+    if (this->buffer_size > 0)
+    {
+        size_t fill = std::min(size, sizeof(this->buffer) - this->buffer_size);
+        std::memcpy(this->buffer + this->buffer_size, p, fill);
+        this->buffer_size += fill;
+        p += fill;
+        if (this->buffer_size < sizeof(this->buffer))
+        {
+            return;
+        }
+        for (int i = 0; i < 4; i++)
+        {
+            this->v[i] = round64(this->v[i], read64(this->buffer + i * 8));
+        }
+        this->buffer_size = 0;
+    }
+
+    while (end - p >= 32)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            this->v[i] = round64(this->v[i], read64(p + i * 8));
+        }
+        p += 32;
+    }
+
+    std::memcpy(this->buffer, p, end - p);
+    this->buffer_size = end - p;
+}
+
+uint64_t Hash64::digest() const
+{
+    uint64_t h;
+    if (this->total_length >= 32)
+    {
+        h = rotl64(this->v[0], 1) + rotl64(this->v[1], 7) + rotl64(this->v[2], 12) + rotl64(this->v[3], 18);
+        for (int i = 0; i < 4; i++)
+        {
+            h = merge_round64(h, this->v[i]);
+        }
+    }
+    else
+    {
+        h = this->seed + PRIME64_5;
+    }
+    h += this->total_length;
+
+    const unsigned char *p = this->buffer;
+    const unsigned char *end = this->buffer + this->buffer_size;
+    while (end - p >= 8)
+    {
+        h ^= round64(0, read64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+    if (end - p >= 4)
+    {
+        h ^= (uint64_t)read32(p) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    while (p < end)
+    {
+        h ^= (*p) * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t hash_bytes(const void *data, size_t size, uint64_t seed)
+{
+    Hash64 hash(seed);
+    hash.update(data, size);
+    return hash.digest();
+}
+
+uint64_t hash_string(const std::string& s, uint64_t seed)
+{
+    return hash_bytes(s.data(), s.size(), seed);
+}
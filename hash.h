@@ -0,0 +1,29 @@
+#ifndef AUDIO_SLICER_HASH_H
+#define AUDIO_SLICER_HASH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+/*
+ * 64-bit xxHash (XXH64). Data can be fed in pieces of any size, the digest is the same as
+ * hashing everything at once.
+ */
+class Hash64 {
+private:
+    uint64_t seed;
+    uint64_t v[4];
+    uint64_t total_length;
+    unsigned char buffer[32];
+    size_t buffer_size;
+
+public:
+    explicit Hash64(uint64_t seed = 0);
+    void update(const void *data, size_t size);
+    uint64_t digest() const;
+};
+
+uint64_t hash_bytes(const void *data, size_t size, uint64_t seed = 0);
+uint64_t hash_string(const std::string& s, uint64_t seed = 0);
+
+#endif //AUDIO_SLICER_HASH_H
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "ioschedule.h"
+
+// Inputs read ahead of the one being sliced.
+static constexpr size_t READAHEAD_FILES = 2;
+
+// Bytes read ahead of each, enough for the first reads of the decoder without filling memory with long inputs.
+static constexpr uint64_t READAHEAD_BYTES = (uint64_t)32 << 20;
+
+struct LocationKey {
+    std::string directory;
+    // 0: physical position of the first extent, 1: inode number, 2: unknown.
+    int kind;
+    uint64_t value;
+    size_t index;
+};
+
+static LocationKey location_of(const std::filesystem::path& path, size_t index)
+{
+    LocationKey key {path.parent_path().string(), 2, 0, index};
+#ifdef __linux__
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return key;
+    }
+    struct stat st {};
+    if (fstat(fd, &st) == 0)
+    {
+        key.kind = 1;
+        key.value = (uint64_t)st.st_ino;
+    }
+    // Only the first extent is asked for; data still waiting for allocation has no position yet.
+    alignas(struct fiemap) char request[sizeof(struct fiemap) + sizeof(struct fiemap_extent)] {};
+    auto *map = reinterpret_cast<struct fiemap *>(request);
+    map->fm_start = 0;
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = 1;
+    if ((ioctl(fd, FS_IOC_FIEMAP, map) == 0) && (map->fm_mapped_extents == 1) &&
+        !(map->fm_extents[0].fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC)))
+    {
+        key.kind = 0;
+        key.value = map->fm_extents[0].fe_physical;
+    }
+    close(fd);
+#endif
+    return key;
+}
+
+std::vector<size_t> locality_order(const std::vector<std::filesystem::path>& paths, std::vector<size_t> indices)
+{
+    std::vector<LocationKey> keys;
+    keys.reserve(indices.size());
+    for (size_t index : indices)
+    {
+        keys.push_back(location_of(paths[index], index));
+    }
+    std::stable_sort(keys.begin(), keys.end(), [](const LocationKey& a, const LocationKey& b)
+    {
+        if (a.directory != b.directory)
+        {
+            return a.directory < b.directory;
+        }
+        return (a.kind != b.kind) ? (a.kind < b.kind) : ((a.kind < 2) && (a.value < b.value));
+    });
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        indices[i] = keys[i].index;
+    }
+    return indices;
+}
+
+#ifdef __linux__
+static void advise(const std::filesystem::path& path, uint64_t length, int advice)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        // The advice applies to the file's pages, which outlive this descriptor.
+        posix_fadvise(fd, 0, (off_t)length, advice);
+        close(fd);
+    }
+}
+#endif
+
+ReadaheadHints::ReadaheadHints(std::vector<std::filesystem::path> paths)
+        : paths(std::move(paths)),
+          advised(0)
+{}
+
+void ReadaheadHints::begin(size_t position)
+{
+    size_t end = std::min(this->paths.size(), position + 1 + READAHEAD_FILES);
+    for (size_t i = std::max(this->advised, position); i < end; i++)
+    {
+#ifdef __linux__
+        advise(this->paths[i], READAHEAD_BYTES, POSIX_FADV_WILLNEED);
+#endif
+    }
+    this->advised = std::max(this->advised, end);
+}
+
+void ReadaheadHints::end(size_t position)
+{
+#ifdef __linux__
+    advise(this->paths[position], 0, POSIX_FADV_DONTNEED);
+#else
+    (void)position;
+#endif
+}
+
+SndfileHandle open_sequential(const std::filesystem::path& path)
+{
+#ifdef __linux__
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0)
+    {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        // The handle closes the descriptor, also when the file cannot be opened as audio.
+        return SndfileHandle(fd, true, SFM_READ);
+    }
+#endif
+    // Opened by name, so that a failure reports why.
+    return SndfileHandle(path.string().data());
+}
@@ -0,0 +1,45 @@
+#ifndef AUDIO_SLICER_IOSCHEDULE_H
+#define AUDIO_SLICER_IOSCHEDULE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <filesystem>
+
+#include <sndfile.hh>
+
+/*
+ * Orders the inputs at the given indices so that reading them in turn seeks as little as
+ * possible: by directory, then within a directory by the physical position of each file's first
+ * extent (FIEMAP, on Linux) or, where the file system does not report it, by inode number, which
+ * most file systems allocate close to the data. Inputs that cannot be inspected keep their
+ * relative order, after the others of their directory. Returns the reordered indices.
+ */
+std::vector<size_t> locality_order(const std::vector<std::filesystem::path>& paths, std::vector<size_t> indices);
+
+/*
+ * Access hints for a batch that reads its inputs one after another, in the order given. While an
+ * input is sliced, the kernel is asked to read ahead the beginning of the next few (WILLNEED);
+ * once it is done, its pages are dropped from the page cache (DONTNEED), so that a large batch
+ * does not push everything else out. Only hints: they do nothing where posix_fadvise is missing,
+ * and errors are ignored.
+ */
+class ReadaheadHints {
+private:
+    std::vector<std::filesystem::path> paths;
+    // Inputs before this one have been asked to be read ahead.
+    size_t advised;
+
+public:
+    explicit ReadaheadHints(std::vector<std::filesystem::path> paths);
+
+    // Call before reading the input at position.
+    void begin(size_t position);
+    // Call once the input at position will not be read again.
+    void end(size_t position);
+};
+
+// Opens an input for reading, telling the kernel it is read sequentially so that it reads ahead further.
+SndfileHandle open_sequential(const std::filesystem::path& path);
+
+#endif //AUDIO_SLICER_IOSCHEDULE_H
@@ -0,0 +1,283 @@
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "fields.h"
+#include "journal.h"
+
+// First line of a journal file, bumped whenever the layout changes.
+static const char JOURNAL_HEADER[] = "audio_slicer journal 2";
+
+// Suffix of outputs that are still being written.
+static const char PARTIAL_SUFFIX[] = ".part";
+
+// Records are forced to disk after this many, or this long after the last time, whichever comes first.
+static constexpr size_t SYNC_RECORDS = 64;
+static constexpr auto SYNC_INTERVAL = std::chrono::seconds(1);
+
+static std::FILE *open_file(const std::filesystem::path& path, bool append)
+{
+#ifdef _WIN32
+    return _wfopen(path.wstring().c_str(), append ? L"ab" : L"wb");
+#else
+    return std::fopen(path.string().c_str(), append ? "ab" : "wb");
+#endif
+}
+
+/*
+ * Forces files to disk: on Linux with one syncfs per file system they are on, which costs the
+ * same for a thousand clips as for one; elsewhere file by file.
+ */
+static void sync_outputs(const std::vector<std::filesystem::path>& outputs)
+{
+#ifdef __linux__
+    std::set<dev_t> synced;
+    for (const auto& output : outputs)
+    {
+        struct stat st {};
+        if ((stat(output.c_str(), &st) != 0) || synced.count(st.st_dev))
+        {
+            continue;
+        }
+        int fd = open(output.c_str(), O_RDONLY | O_CLOEXEC);
+        int result = (fd >= 0) ? syncfs(fd) : -1;
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        if (result != 0)
+        {
+            throw std::runtime_error("Cannot sync " + output.string());
+        }
+        synced.insert(st.st_dev);
+    }
+#else
+    for (const auto& output : outputs)
+    {
+        sync_file(output);
+    }
+#endif
+}
+
+Journal::Journal(std::filesystem::path path, bool resume)
+        : path(std::move(path)),
+          file(nullptr),
+          unsynced(0),
+          last_sync(std::chrono::steady_clock::now())
+{
+    /*
+     * After the header, one line per finished input: "done", parameter hash, input, number of
+     * outputs and the outputs, separated by tabs, with the paths escaped by escape_field. A later
+     * record of the same input replaces the earlier one.
+     */
+    bool append = false;
+    bool torn = false;
+    std::error_code ec;
+    if (resume && std::filesystem::exists(this->path, ec))
+    {
+        std::ifstream is(this->path, std::ios::binary);
+        std::string line;
+        if (!std::getline(is, line) || (line != JOURNAL_HEADER))
+        {
+            throw std::runtime_error("Not a journal: " + this->path.string());
+        }
+        while (std::getline(is, line))
+        {
+            // The last line has no newline if the process died while writing it.
+            torn = is.eof();
+            std::stringstream ss(line);
+            std::string kind, input, field;
+            Entry entry {};
+            size_t output_count = 0;
+            if (!std::getline(ss, kind, '\t') || (kind != "done"))
+            {
+                continue;
+            }
+            ss >> std::hex >> entry.params_hash >> std::dec;
+            ss.ignore(1);
+            if (ss.fail() || !std::getline(ss, input, '\t') || !(ss >> output_count))
+            {
+                continue;
+            }
+            ss.ignore(1);
+            for (size_t i = 0; (i < output_count) && std::getline(ss, field, '\t'); i++)
+            {
+                entry.outputs.push_back(unescape_field(field));
+            }
+            if (torn || (entry.outputs.size() != output_count))
+            {
+                continue;
+            }
+            this->entries[unescape_field(input)] = std::move(entry);
+        }
+        append = true;
+    }
+
+    this->file = open_file(this->path, append);
+    if (!this->file)
+    {
+        throw std::runtime_error("Cannot open journal " + this->path.string());
+    }
+    if (!append)
+    {
+        std::fputs(JOURNAL_HEADER, this->file);
+        std::fputc('\n', this->file);
+    }
+    else if (torn)
+    {
+        // End the torn record, so the next one starts on a line of its own.
+        std::fputc('\n', this->file);
+    }
+    sync();
+}
+
+Journal::~Journal()
+{
+    if (this->file)
+    {
+        try
+        {
+            sync();
+        }
+        catch (const std::runtime_error&)
+        {
+        }
+        std::fclose(this->file);
+    }
+}
+
+bool Journal::finished(const std::filesystem::path& input, uint64_t params_hash, std::vector<std::string> *outputs) const
+{
+    auto it = this->entries.find(input.string());
+    if ((it == this->entries.end()) || (it->second.params_hash != params_hash))
+    {
+        return false;
+    }
+    std::error_code ec;
+    for (const auto& output : it->second.outputs)
+    {
+        if (!std::filesystem::exists(output, ec))
+        {
+            return false;
+        }
+    }
+    if (outputs)
+    {
+        *outputs = it->second.outputs;
+    }
+    return true;
+}
+
+void Journal::record(const std::filesystem::path& input, uint64_t params_hash, const std::vector<std::filesystem::path>& outputs)
+{
+    Entry entry {params_hash, {}};
+    std::stringstream ss;
+    ss << "done\t" << std::hex << params_hash << std::dec << '\t' << escape_field(input.string()) << '\t' << outputs.size();
+    for (const auto& output : outputs)
+    {
+        ss << '\t' << escape_field(output.string());
+        entry.outputs.push_back(output.string());
+        this->unsynced_outputs.push_back(output);
+    }
+    ss << '\n';
+
+    // The whole line is handed to the operating system at once, so only a crash of the machine can tear it.
+    auto line = ss.str();
+    if ((std::fwrite(line.data(), 1, line.size(), this->file) != line.size()) || (std::fflush(this->file) != 0))
+    {
+        throw std::runtime_error("Cannot write journal " + this->path.string());
+    }
+    this->entries[input.string()] = std::move(entry);
+    this->unsynced++;
+    if ((this->unsynced >= SYNC_RECORDS) || (std::chrono::steady_clock::now() - this->last_sync >= SYNC_INTERVAL))
+    {
+        sync();
+    }
+}
+
+void Journal::sync()
+{
+    sync_outputs(this->unsynced_outputs);
+    this->unsynced_outputs.clear();
+    if (std::fflush(this->file) != 0)
+    {
+        throw std::runtime_error("Cannot write journal " + this->path.string());
+    }
+#ifdef _WIN32
+    int result = _commit(_fileno(this->file));
+#else
+    int result = fsync(fileno(this->file));
+#endif
+    if (result != 0)
+    {
+        throw std::runtime_error("Cannot sync journal " + this->path.string());
+    }
+    this->unsynced = 0;
+    this->last_sync = std::chrono::steady_clock::now();
+}
+
+void sync_file(const std::filesystem::path& path)
+{
+#ifdef _WIN32
+    int fd = _wopen(path.c_str(), _O_RDWR | _O_BINARY);
+    int result = (fd >= 0) ? _commit(fd) : -1;
+    if (fd >= 0)
+    {
+        _close(fd);
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    int result = (fd >= 0) ? fsync(fd) : -1;
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+#endif
+    if (result != 0)
+    {
+        throw std::runtime_error("Cannot sync " + path.string());
+    }
+}
+
+std::filesystem::path partial_path(const std::filesystem::path& output)
+{
+    auto partial = output;
+    partial += PARTIAL_SUFFIX;
+    return partial;
+}
+
+void commit_output(const std::filesystem::path& output)
+{
+    std::filesystem::rename(partial_path(output), output);
+}
+
+size_t remove_partial_outputs(const std::filesystem::path& dir)
+{
+    // Only names this program writes: clips and statistics with the partial suffix.
+    size_t removed = 0;
+    std::error_code ec;
+    for (const auto& item : std::filesystem::directory_iterator(dir, ec))
+    {
+        auto name = item.path().filename().string();
+        for (const char *extension : {".wav", ".csv"})
+        {
+            std::string suffix = std::string(extension) + PARTIAL_SUFFIX;
+            if ((name.size() > suffix.size()) && (name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) &&
+                item.is_regular_file(ec) && std::filesystem::remove(item.path(), ec))
+            {
+                removed++;
+            }
+        }
+    }
+    return removed;
+}
@@ -0,0 +1,64 @@
+#ifndef AUDIO_SLICER_JOURNAL_H
+#define AUDIO_SLICER_JOURNAL_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <filesystem>
+
+/*
+ * Append-only record of the inputs a batch has finished, with the parameters they were sliced
+ * with and the files written for each, so that an interrupted batch can resume where it
+ * stopped. Every record reaches the operating system as soon as it is written, which survives
+ * the process being killed; records are forced to disk in batches, each after the outputs it
+ * names, so a power loss can only lose the last few, whose inputs are then sliced again.
+ */
+class Journal {
+private:
+    struct Entry {
+        uint64_t params_hash;
+        std::vector<std::string> outputs;
+    };
+
+    std::filesystem::path path;
+    std::FILE *file;
+    std::unordered_map<std::string, Entry> entries;
+    size_t unsynced;
+    // Outputs of the records since the last sync, which are forced to disk before the records.
+    std::vector<std::filesystem::path> unsynced_outputs;
+    std::chrono::steady_clock::time_point last_sync;
+
+public:
+    /*
+     * Starts a new journal, replacing any file at path, or with resume, continues an existing one
+     * and loads its records; a record cut short by a crash is ignored. Throws std::runtime_error if the file cannot be
+     * opened or is not a journal.
+     */
+    Journal(std::filesystem::path path, bool resume);
+    ~Journal();
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Whether the input was finished with these parameters and all its outputs still exist.
+    bool finished(const std::filesystem::path& input, uint64_t params_hash, std::vector<std::string> *outputs = nullptr) const;
+    // Throws std::runtime_error if the record cannot be written.
+    void record(const std::filesystem::path& input, uint64_t params_hash, const std::vector<std::filesystem::path>& outputs);
+    void sync();
+};
+
+// Forces a closed file to disk; throws std::runtime_error if it cannot.
+void sync_file(const std::filesystem::path& path);
+
+// Name an output is written under until it is complete.
+std::filesystem::path partial_path(const std::filesystem::path& output);
+
+// Renames the complete partial file of an output to its final name.
+void commit_output(const std::filesystem::path& output);
+
+// Removes the partial outputs that an interrupted run left in a directory; returns how many.
+size_t remove_partial_outputs(const std::filesystem::path& dir);
+
+#endif //AUDIO_SLICER_JOURNAL_H
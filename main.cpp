@@ -1,22 +1,725 @@
 #include <vector>
 #include <tuple>
+#include <algorithm>
 #include <cmath>
 #include <stdexcept>
 #include <iostream>
 #include <filesystem>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <numeric>
+#include <set>
+#include <chrono>
 
 #include <argparse/argparse.hpp>
 
 #include <sndfile.hh>
 
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
 #include "slicer.h"
+#include "cache.h"
+#include "hash.h"
+#include "transform.h"
+#include "bufferpool.h"
+#include "wavcopy.h"
+#include "decoder.h"
+#include "shard.h"
+#include "journal.h"
+#include "perfcounters.h"
+#include "clipoutput.h"
+#include "ioschedule.h"
+
+// Number of frames read from or written to a file at a time when streaming.
+constexpr sf_count_t STREAM_BLOCK_FRAMES = 65536;
+// Smaller blocks for live input, since a clip cannot be flushed before its block has been read.
+constexpr sf_count_t LIVE_BLOCK_FRAMES = 4096;
+// The manifest is rewritten at most this often during a batch, so a killed run keeps most of it.
+constexpr std::chrono::seconds MANIFEST_SAVE_INTERVAL(30);
+
+static void copy_frames(SndfileHandle& src, SndfileHandle& dst, sf_count_t begin, sf_count_t count, std::vector<float>& buffer, ChunkStats *stats = nullptr)
+{
+    int channels = src.channels();
+    buffer.resize(STREAM_BLOCK_FRAMES * channels);
+    if (src.seek(begin, SEEK_SET) != begin)
+    {
+        throw std::runtime_error("Cannot seek in the input");
+    }
+    while (count > 0)
+    {
+        auto frames_read = src.readf(buffer.data(), std::min(count, STREAM_BLOCK_FRAMES));
+        if (frames_read <= 0)
+        {
+            throw std::runtime_error("The input ended before the clip");
+        }
+        if (stats)
+        {
+            Slicer::sample_stats(buffer.data(), (uint64_t)(frames_read * channels), *stats);
+        }
+        dst.writef(buffer.data(), frames_read);
+        count -= frames_read;
+    }
+}
+
+static GainMode parse_gain_mode(const std::string& name)
+{
+    if (name == "none")  return GainMode::None;
+    if (name == "peak")  return GainMode::Peak;
+    if (name == "rms")   return GainMode::Rms;
+    if (name == "lufs")  return GainMode::Lufs;
+    throw std::invalid_argument("Unknown normalization: " + name);
+}
+
+static int parse_raw_format(const std::string& name)
+{
+    if (name == "u8")    return SF_FORMAT_PCM_U8;
+    if (name == "s8")    return SF_FORMAT_PCM_S8;
+    if (name == "s16")   return SF_FORMAT_PCM_16;
+    if (name == "s24")   return SF_FORMAT_PCM_24;
+    if (name == "s32")   return SF_FORMAT_PCM_32;
+    if (name == "f32")   return SF_FORMAT_FLOAT;
+    throw std::invalid_argument("Unknown raw sample format: " + name);
+}
+
+// What to do with an input whose only clip is the whole input.
+enum class WholeFileMode {
+    Write,
+    Copy,
+    Link,
+    Skip
+};
+
+static WholeFileMode parse_whole_file_mode(const std::string& name)
+{
+    if (name == "write") return WholeFileMode::Write;
+    if (name == "copy")  return WholeFileMode::Copy;
+    if (name == "link")  return WholeFileMode::Link;
+    if (name == "skip")  return WholeFileMode::Skip;
+    throw std::invalid_argument("Unknown whole file mode: " + name);
+}
+
+static ChannelMode parse_channel_mode(const std::string& name)
+{
+    if (name == "mix")   return ChannelMode::Mix;
+    if (name == "max")   return ChannelMode::Max;
+    if (name == "power") return ChannelMode::Power;
+    throw std::invalid_argument("Unknown channel mode: " + name);
+}
+
+static void place_whole_file(const std::filesystem::path& src, const std::filesystem::path& dst, WholeFileMode mode)
+{
+    std::filesystem::remove(dst);
+    if (mode == WholeFileMode::Link)
+    {
+        // Hard links fail across file systems; a copy is the next best thing.
+        std::error_code ec;
+        std::filesystem::create_hard_link(src, dst, ec);
+        if (!ec)
+        {
+            return;
+        }
+    }
+    std::filesystem::copy_file(src, dst, std::filesystem::copy_options::overwrite_existing);
+}
+
+/*
+ * Writes the clips of a StreamSlicer while audio is being fed to it. Frames are kept in memory
+ * only until the slicer has committed them.
+ */
+class ClipWriter {
+private:
+    std::filesystem::path out;
+    std::string stem;
+    int format;
+    int channels;
+    int sr;
+
+    std::vector<float> pending;
+    uint64_t pending_begin;
+    uint64_t written;
+    int idx;
+    SndfileHandle wf;
+    // Frame the open clip starts at.
+    uint64_t clip_begin;
+
+    std::filesystem::path clip_path() const
+    {
+        std::stringstream ss;
+        ss << this->stem << "_" << this->idx << ".wav";
+        return this->out / ss.str();
+    }
+
+    void write_range(uint64_t begin, uint64_t end)
+    {
+        if (end <= begin)
+        {
+            return;
+        }
+        if (!this->wf)
+        {
+            this->wf = SndfileHandle(clip_path().string().data(), SFM_WRITE, this->format, this->channels, this->sr);
+            this->clip_begin = begin;
+        }
+        this->wf.writef(this->pending.data() + (begin - this->pending_begin) * this->channels, (sf_count_t)(end - begin));
+        this->written = end;
+    }
+
+public:
+    ClipWriter(std::filesystem::path out, std::string stem, int format, int channels, int sr)
+            : out(std::move(out)),
+              stem(std::move(stem)),
+              format(format),
+              channels(channels),
+              sr(sr),
+              pending_begin(0),
+              written(0),
+              idx(0),
+              clip_begin(0)
+    {}
+
+    void push(const float *block, uint64_t frames)
+    {
+        this->pending.insert(this->pending.end(), block, block + frames * this->channels);
+    }
+
+    void close_chunks(const std::vector<std::tuple<uint64_t, uint64_t>>& chunks)
+    {
+        for (auto chunk : chunks)
+        {
+            write_range(std::max(std::get<0>(chunk), this->written), std::get<1>(chunk));
+            this->written = std::get<1>(chunk);
+            if (this->wf)
+            {
+                this->wf = SndfileHandle();
+                this->idx++;
+            }
+        }
+    }
+
+    void advance(const StreamSlicer& stream)
+    {
+        uint64_t committed = stream.committed();
+        if (stream.has_open_chunk())
+        {
+            write_range(std::max(stream.open_chunk_begin(), this->written), committed);
+        }
+        // Drop committed frames, but only once they make up half of the buffer to keep erasing cheap.
+        if ((committed - this->pending_begin) * this->channels * 2 >= this->pending.size())
+        {
+            this->pending.erase(this->pending.begin(), this->pending.begin() + (committed - this->pending_begin) * this->channels);
+            this->pending_begin = committed;
+        }
+    }
+
+    void save_state(std::ostream& os)
+    {
+        // The uncommitted frames are not saved, they are read again from the input on resume.
+        bool clip_open = this->wf;
+        os.write(reinterpret_cast<const char *>(&this->written), sizeof(this->written));
+        os.write(reinterpret_cast<const char *>(&this->idx), sizeof(this->idx));
+        os.write(reinterpret_cast<const char *>(&clip_open), sizeof(clip_open));
+        os.write(reinterpret_cast<const char *>(&this->clip_begin), sizeof(this->clip_begin));
+        this->wf = SndfileHandle();
+        // The state must never count frames that are not on disk yet.
+        if (clip_open)
+        {
+            sync_file(clip_path());
+        }
+    }
+
+    void load_state(std::istream& is, uint64_t committed)
+    {
+        bool clip_open;
+        is.read(reinterpret_cast<char *>(&this->written), sizeof(this->written));
+        is.read(reinterpret_cast<char *>(&this->idx), sizeof(this->idx));
+        is.read(reinterpret_cast<char *>(&clip_open), sizeof(clip_open));
+        is.read(reinterpret_cast<char *>(&this->clip_begin), sizeof(this->clip_begin));
+        if (!is)
+        {
+            throw std::runtime_error("Saved state is truncated");
+        }
+        this->pending.clear();
+        this->pending_begin = committed;
+        if (clip_open)
+        {
+            /*
+             * Keep appending to the clip that was being written when the state was saved. Frames
+             * written after that are dropped, since they are fed and written again.
+             */
+            this->wf = SndfileHandle(clip_path().string().data(), SFM_RDWR);
+            auto saved = (sf_count_t)(this->written - this->clip_begin);
+            if (this->wf.error() || (this->wf.frames() < saved))
+            {
+                throw std::runtime_error("Clip " + clip_path().string() + " is shorter than the saved state");
+            }
+            if ((this->wf.frames() > saved) && (this->wf.command(SFC_FILE_TRUNCATE, &saved, sizeof(saved)) != 0))
+            {
+                throw std::runtime_error("Cannot truncate " + clip_path().string());
+            }
+            this->wf.seek(saved, SEEK_SET);
+        }
+    }
+};
+
+static void slice_stream(SndfileHandle& handle, Slicer& slicer, const std::filesystem::path& out, const std::string& stem, int format)
+{
+    /*
+     * Slices audio that can only be read once, front to back. Each clip is written while the
+     * audio arrives and closed as soon as StreamSlicer returns its chunk.
+     */
+    int channels = handle.channels();
+    StreamSlicer stream(slicer);
+    ClipWriter writer(out, stem, format, channels, handle.samplerate());
+
+    std::vector<float> block(LIVE_BLOCK_FRAMES * channels);
+    sf_count_t frames_read;
+    while ((frames_read = handle.readf(block.data(), LIVE_BLOCK_FRAMES)) > 0)
+    {
+        writer.push(block.data(), (uint64_t)frames_read);
+        writer.close_chunks(stream.feed(block.data(), (uint64_t)frames_read, (unsigned int)channels));
+        writer.advance(stream);
+    }
+    writer.close_chunks(stream.finish());
+}
+
+static void slice_resumable(SndfileHandle& handle, Slicer& slicer, const std::filesystem::path& out, const std::string& stem,
+                            const std::filesystem::path& state_path, bool final)
+{
+    /*
+     * Slices a recording that may still be growing. The slicer and writer state is loaded from
+     * state_path if it exists, only the frames appended since the last run are fed, and the
+     * state is saved again for the next run. The last clip is only completed with final.
+     */
+    int channels = handle.channels();
+    StreamSlicer stream(slicer);
+    ClipWriter writer(out, stem, handle.format(), channels, handle.samplerate());
+    std::vector<float> block(STREAM_BLOCK_FRAMES * channels);
+    sf_count_t frames_read;
+
+    if (std::filesystem::exists(state_path))
+    {
+        std::ifstream is(state_path, std::ios::binary);
+        stream.load_state(is);
+        writer.load_state(is, stream.committed());
+
+        // Read back the frames that were fed last time but not written yet.
+        auto count = (sf_count_t)(stream.frames() - stream.committed());
+        handle.seek((sf_count_t)stream.committed(), SEEK_SET);
+        while ((count > 0) && ((frames_read = handle.readf(block.data(), std::min(count, STREAM_BLOCK_FRAMES))) > 0))
+        {
+            writer.push(block.data(), (uint64_t)frames_read);
+            count -= frames_read;
+        }
+        if (count > 0)
+        {
+            throw std::runtime_error("Input is shorter than the saved state, it must only be appended to");
+        }
+    }
+
+    while ((frames_read = handle.readf(block.data(), STREAM_BLOCK_FRAMES)) > 0)
+    {
+        writer.push(block.data(), (uint64_t)frames_read);
+        writer.close_chunks(stream.feed(block.data(), (uint64_t)frames_read, (unsigned int)channels));
+        writer.advance(stream);
+    }
+
+    if (final)
+    {
+        writer.close_chunks(stream.finish());
+        std::filesystem::remove(state_path);
+        return;
+    }
+    // Write to a temporary file first, so an interrupted run never leaves a broken state behind.
+    auto tmp_path = state_path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream os(tmp_path, std::ios::binary | std::ios::trunc);
+        stream.save_state(os);
+        writer.save_state(os);
+        if (!os.flush())
+        {
+            throw std::runtime_error("Cannot write state file " + tmp_path.string());
+        }
+    }
+    sync_file(tmp_path);
+    std::filesystem::rename(tmp_path, state_path);
+}
+
+struct SliceOptions {
+    double db_thresh;
+    uint64_t min_length;
+    uint64_t min_interval;
+    uint64_t hop_size;
+    uint64_t max_sil_kept;
+    uint64_t max_length;
+    bool two_pass;
+    bool stats;
+    ClipTransform transform;
+    bool auto_threshold;
+    double noise_percentile;
+    double auto_offset_db;
+    uint64_t auto_window;
+    WholeFileMode whole_file;
+    ChannelMode channel_mode;
+    // These do not change the output, so they are not part of the cache key.
+    unsigned int decode_threads;
+    bool direct_io;
+};
+
+// What the batch does with an input, decided before the first one is sliced.
+enum class InputPlan {
+    Slice,
+    // Finished by the run being resumed.
+    Journaled,
+    Cached,
+    // Could not be checked against the journal or the cache.
+    Failed
+};
+
+static double to_db(double amplitude)
+{
+    return 20.0 * std::log10(std::max(amplitude, 1e-10));
+}
+
+static void write_stats(const std::filesystem::path& stats_path, int sr,
+                        const std::vector<std::tuple<std::string, ChunkStats>>& clips)
+{
+    // One CSV row per written clip. Times are in seconds, levels in dBFS.
+    std::ofstream os(stats_path, std::ios::trunc);
+    os << "clip,begin,end,duration,peak_db,clipped,mean_rms_db,max_rms_db,snr_db,leading_silence,trailing_silence\n";
+    for (const auto& clip : clips)
+    {
+        const ChunkStats& stats = std::get<1>(clip);
+        os << std::get<0>(clip) << ','
+           << (double)stats.begin / sr << ','
+           << (double)stats.end / sr << ','
+           << (double)(stats.end - stats.begin) / sr << ','
+           << to_db(stats.peak) << ','
+           << stats.clipped << ','
+           << to_db(stats.mean_rms) << ','
+           << to_db(stats.max_rms) << ','
+           << stats.snr_db << ','
+           << (double)stats.leading_silence / sr << ','
+           << (double)stats.trailing_silence / sr << '\n';
+    }
+    if (!os.flush())
+    {
+        throw std::runtime_error("Cannot write " + stats_path.string());
+    }
+}
+
+static uint64_t hash_options(const SliceOptions& options, const std::filesystem::path& out)
+{
+    // Everything that changes which clips are written, and where.
+    std::stringstream ss;
+    ss << "db_thresh=" << options.db_thresh
+       << " min_length=" << options.min_length
+       << " min_interval=" << options.min_interval
+       << " hop_size=" << options.hop_size
+       << " max_sil_kept=" << options.max_sil_kept
+       << " max_length=" << options.max_length
+       << " stats=" << options.stats
+       << " gain_mode=" << (int)options.transform.gain_mode
+       << " target_db=" << options.transform.target_db
+       << " target_sr=" << options.transform.target_sr
+       << " quality=" << options.transform.quality
+       << " auto_threshold=" << options.auto_threshold
+       << " noise_percentile=" << options.noise_percentile
+       << " auto_offset_db=" << options.auto_offset_db
+       << " auto_window=" << options.auto_window
+       << " whole_file=" << (int)options.whole_file
+       << " channel_mode=" << (int)options.channel_mode
+       << " out=" << out.string();
+    return hash_string(ss.str());
+}
+
+// Counts of the stages of slicing one input: decoding, finding the clips and writing them.
+struct StagePerf {
+    PerfCounts decode;
+    PerfCounts analyze;
+    PerfCounts write;
+};
+
+static void write_perf_rows(std::ostream& os, const std::string& input, const StagePerf& perf)
+{
+    // The input comes last, so commas in its name do not shift the other columns.
+    for (const auto& stage : {std::make_tuple("decode", perf.decode), std::make_tuple("analyze", perf.analyze),
+                              std::make_tuple("write", perf.write)})
+    {
+        const PerfCounts& counts = std::get<1>(stage);
+        // A stage that never ran is still all zero, and would only make the totals look unavailable.
+        if ((counts.seconds <= 0) && (std::find(std::begin(counts.available), std::end(counts.available), true) == std::end(counts.available)))
+        {
+            continue;
+        }
+        os << std::get<0>(stage) << ',' << counts.seconds;
+        for (int i = 0; i < PERF_EVENT_COUNT; i++)
+        {
+            os << ',';
+            if (counts.available[i])
+            {
+                os << counts.events[i];
+            }
+        }
+        os << ',' << input << '\n';
+    }
+}
+
+static std::vector<std::filesystem::path> slice_file(const std::filesystem::path& path, const std::filesystem::path& out, const SliceOptions& options,
+                                                     const PerfCounters *counters = nullptr, StagePerf *perf = nullptr)
+{
+    PerfCounts mark = counters ? counters->read() : PerfCounts {};
+    auto lap = [&](PerfCounts StagePerf::*stage)
+    {
+        if (counters && perf)
+        {
+            PerfCounts now = counters->read();
+            perf->*stage = now - mark;
+            mark = now;
+        }
+    };
+
+    SndfileHandle handle = open_sequential(path);
+    if (handle.error())
+    {
+        throw std::runtime_error("Cannot open " + path.string() + ": " + handle.strError());
+    }
+    int channels = handle.channels();
+    int sr = handle.samplerate();
+    int format = handle.format();
+    auto frames = handle.frames();
+
+    Slicer slicer(sr, options.db_thresh, options.min_length, options.min_interval, options.hop_size, options.max_sil_kept);
+    slicer.set_max_length(options.max_length);
+    slicer.set_channel_mode(options.channel_mode);
+    if (options.auto_threshold)
+    {
+        slicer.set_auto_threshold(options.noise_percentile, options.auto_offset_db, options.auto_window);
+    }
+
+    // The whole input is decoded into a pooled buffer, which stays mapped for the next input.
+    BufferPool::Lease decoded;
+    std::vector<float> block;
+    const float *audio = nullptr;
+    std::vector<std::tuple<uint64_t, uint64_t>> chunks;
+    std::vector<ChunkStats> chunk_stats;
+    if (options.two_pass)
+    {
+        // Decoding is spread over both passes, so it is counted as part of them.
+        lap(&StagePerf::decode);
+        // Pass one: only the RMS envelope is kept, the samples are discarded block by block.
+        RmsEnvelope envelope(slicer.get_win_size(), slicer.get_hop_size());
+        block.resize(STREAM_BLOCK_FRAMES * channels);
+        sf_count_t frames_read;
+        while ((frames_read = handle.readf(block.data(), STREAM_BLOCK_FRAMES)) > 0)
+        {
+            envelope.feed(block.data(), (uint64_t)frames_read, (unsigned int)channels);
+        }
+        frames = (sf_count_t)envelope.frames();
+        auto rms_list = envelope.finish();
+        chunks = slicer.slice_envelope(rms_list, (uint64_t)frames);
+        if (options.stats)
+        {
+            // Peaks are added in pass two, while each clip is copied.
+            chunk_stats = slicer.envelope_stats(rms_list, chunks);
+        }
+    }
+    else
+    {
+        decoded = BufferPool::shared().acquire((uint64_t)(frames * channels));
+        // Pooled buffers are not cleared, so only what was decoded may be used; a truncated file ends early.
+        auto frames_decoded = decode_frames(handle, path, decoded.data(), frames, options.decode_threads);
+        if ((frames_decoded <= 0) && (frames > 0))
+        {
+            throw std::runtime_error("Cannot read " + path.string());
+        }
+        frames = std::max(frames_decoded, (sf_count_t)0);
+        audio = decoded.data();
+        lap(&StagePerf::decode);
+        if (options.stats)
+        {
+            chunks = slicer.slice(audio, (uint64_t)(frames * channels), (unsigned int)channels, chunk_stats);
+        }
+        else
+        {
+            chunks = slicer.slice(audio, (uint64_t)(frames * channels), (unsigned int)channels);
+        }
+    }
+    auto total_size = frames * channels;
+    lap(&StagePerf::analyze);
+
+    std::unique_ptr<ClipProcessor> processor;
+    BufferPool::Lease clip_buffer;
+    if (options.transform.enabled())
+    {
+        processor = std::make_unique<ClipProcessor>(options.transform, sr, (unsigned int)channels);
+    }
+
+    /*
+     * A single clip covering the whole input is the input itself, so it can be copied or linked
+     * instead of encoded again. Two-pass statistics need the samples, which are read while
+     * writing, so they always take the normal path.
+     */
+    bool whole_file = (options.whole_file != WholeFileMode::Write) && !processor &&
+            !(options.two_pass && options.stats) && (chunks.size() == 1) &&
+            (std::get<0>(chunks[0]) == 0) && (std::get<1>(chunks[0]) == (uint64_t)frames);
+    if (whole_file && (options.whole_file == WholeFileMode::Skip))
+    {
+        chunks.clear();
+    }
+
+    // Clips of an uncompressed WAV input keep its encoding, so their bytes can be copied as they are.
+    WavLayout wav_layout {};
+    bool copy_wav = !processor && !(options.two_pass && options.stats) &&
+            ((format & SF_FORMAT_TYPEMASK) == SF_FORMAT_WAV) && read_wav_layout(path, wav_layout) &&
+            (wav_layout.channels == channels) && (wav_layout.data_size / wav_layout.block_align == (uint64_t)frames);
+
+    // Clips in memory are encoded into a buffer and written at once; two-pass clips are streamed from the input.
+    ClipOutput& clip_output = ClipOutput::for_thread();
+    std::vector<std::filesystem::path> outputs;
+    std::vector<std::tuple<std::string, ChunkStats>> written_stats;
+    int idx = 0;
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        auto chunk = chunks[i];
+        auto begin_frame = std::get<0>(chunk) * channels;
+        auto end_frame = std::get<1>(chunk) * channels;
+        auto frame_count = (sf_count_t)(end_frame - begin_frame);
+        if ((begin_frame == end_frame) || (begin_frame > total_size) || (end_frame > total_size))
+        {
+            continue;
+        }
+        std::stringstream ss;
+        ss << path.stem().string() << "_" << idx << ".wav";
+        std::filesystem::path out_file_path = out / ss.str();
+        // Clips are written under a partial name and renamed once complete, so no crash leaves a truncated clip behind.
+        std::filesystem::path part_path = partial_path(out_file_path);
+        if (whole_file)
+        {
+            place_whole_file(path, part_path, options.whole_file);
+        }
+        else if (processor)
+        {
+            // Transforms need the whole clip at once, so pass two reads it into memory.
+            const float *clip = audio + begin_frame;
+            if (options.two_pass)
+            {
+                if (clip_buffer.size() < (uint64_t)frame_count)
+                {
+                    // Give the smaller buffer back first, so this lease alone never waits on the pool limit.
+                    clip_buffer = BufferPool::Lease();
+                    clip_buffer = BufferPool::shared().acquire((uint64_t)frame_count);
+                }
+                // The lease is not cleared, so a short read would leave samples of an earlier input in the clip.
+                if ((handle.seek((sf_count_t)std::get<0>(chunk), SEEK_SET) != (sf_count_t)std::get<0>(chunk)) ||
+                    (handle.readf(clip_buffer.data(), frame_count / channels) != frame_count / channels))
+                {
+                    throw std::runtime_error("Cannot read " + path.string());
+                }
+                if (options.stats)
+                {
+                    Slicer::sample_stats(clip_buffer.data(), (uint64_t)frame_count, chunk_stats[i]);
+                }
+                clip = clip_buffer.data();
+            }
+            const auto& processed = processor->process(clip, (uint64_t)(frame_count / channels));
+            if (!clip_output.write(part_path, format, channels, processor->output_rate(), processed.data(), processed.size() / channels,
+                                   options.direct_io))
+            {
+                SndfileHandle wf = SndfileHandle(part_path.string().data(), SFM_WRITE, format, channels, processor->output_rate());
+                wf.write(processed.data(), (sf_count_t)processed.size());
+            }
+        }
+        else if (!copy_wav || !copy_wav_clip(path, wav_layout, std::get<0>(chunk), std::get<1>(chunk), part_path))
+        {
+            if (options.two_pass)
+            {
+                // Pass two: read back only the frames of this clip.
+                SndfileHandle wf = SndfileHandle(part_path.string().data(), SFM_WRITE, format, channels, sr);
+                copy_frames(handle, wf, (sf_count_t)std::get<0>(chunk), frame_count / channels, block,
+                            options.stats ? &chunk_stats[i] : nullptr);
+            }
+            else if (!clip_output.write(part_path, format, channels, sr, audio + begin_frame, (uint64_t)(frame_count / channels),
+                                        options.direct_io))
+            {
+                SndfileHandle wf = SndfileHandle(part_path.string().data(), SFM_WRITE, format, channels, sr);
+                wf.write(audio + begin_frame, frame_count);
+            }
+        }
+        commit_output(out_file_path);
+        if (options.stats)
+        {
+            written_stats.emplace_back(ss.str(), chunk_stats[i]);
+        }
+        outputs.push_back(out_file_path);
+        idx++;
+    }
+
+    if (options.stats)
+    {
+        auto stats_path = out / (path.stem().string() + ".csv");
+        write_stats(partial_path(stats_path), sr, written_stats);
+        commit_output(stats_path);
+        outputs.push_back(stats_path);
+    }
+    lap(&StagePerf::write);
+    return outputs;
+}
+
+static int merge_main(int argc, char **argv)
+{
+    argparse::ArgumentParser parser("audio_slicer merge");
+
+    parser.add_argument("manifests")
+            .nargs(argparse::nargs_pattern::at_least_one)
+            .help("The manifests written by every shard of a batch");
+    parser.add_argument("--out")
+            .default_value(std::string("manifest.txt"))
+            .help("The merged manifest, listing every input and clip of the batch");
+
+    try {
+        parser.parse_args(argc, argv);
+    }
+    catch (const std::runtime_error& err) {
+        std::cerr << parser;
+        std::exit(1);
+    }
+
+    try
+    {
+        std::vector<Manifest> shards;
+        for (const auto& manifest : parser.get<std::vector<std::string>>("manifests"))
+        {
+            shards.push_back(Manifest::load(std::filesystem::path(manifest)));
+        }
+        Manifest::merge(shards).save(std::filesystem::path(parser.get("--out")));
+    }
+    catch (const std::exception& err)
+    {
+        std::cerr << err.what() << '\n';
+        return 3;
+    }
+    return 0;
+}
 
 int main(int argc, char **argv)
 {
+    if ((argc > 1) && (std::string(argv[1]) == "merge"))
+    {
+        return merge_main(argc - 1, argv + 1);
+    }
+
     argparse::ArgumentParser parser("audio_slicer");
 
     parser.add_argument("audio")
-            .help("The audio to be sliced");
+            .nargs(argparse::nargs_pattern::at_least_one)
+            .help("The audio files to be sliced, or - to read a stream from standard input");
     parser.add_argument("--out")
             .default_value(std::string())
             .help("Output directory of the sliced audio clips");
@@ -24,6 +727,22 @@ int main(int argc, char **argv)
             .default_value((double)(-40.0))
             .help("The dB threshold for silence detection")
             .scan<'g', double>();
+    parser.add_argument("--auto_threshold")
+            .default_value(false)
+            .implicit_value(true)
+            .help("Estimate the threshold from each input instead of using --db_thresh: the --noise_percentile level of the RMS envelope plus --auto_offset");
+    parser.add_argument("--noise_percentile")
+            .default_value((double)(10.0))
+            .help("Percentile of the RMS levels taken as the noise floor by --auto_threshold")
+            .scan<'g', double>();
+    parser.add_argument("--auto_offset")
+            .default_value((double)(10.0))
+            .help("dB added to the estimated noise floor by --auto_threshold")
+            .scan<'g', double>();
+    parser.add_argument("--auto_window")
+            .default_value((uint64_t)(60000))
+            .help("Milliseconds of audio per noise floor estimate of --auto_threshold, so it follows drifting levels (0 for one estimate per input)")
+            .scan<'i', uint64_t>();
     parser.add_argument("--min_length")
             .default_value((uint64_t)(5000))
             .help("The minimum milliseconds required for each sliced audio clip")
@@ -40,6 +759,106 @@ int main(int argc, char **argv)
             .default_value((uint64_t)(500))
             .help("The maximum silence length kept around the sliced clip, presented in milliseconds")
             .scan<'i', uint64_t>();
+    parser.add_argument("--max_length")
+            .default_value((uint64_t)(0))
+            .help("The maximum milliseconds of each clip; longer clips are split at their quietest points (0 for no limit)")
+            .scan<'i', uint64_t>();
+    parser.add_argument("--channel_mode")
+            .default_value(std::string("mix"))
+            .help("How channels are combined for silence detection: mix (downmix to mono), max (loudest channel, so any active channel keeps audio) or power (RMS over all channels, without phase cancellation)");
+    parser.add_argument("--two_pass")
+            .default_value(false)
+            .implicit_value(true)
+            .help("Do not load the whole audio into memory: compute the silence envelope in a first pass, then seek to each clip in a second pass");
+    parser.add_argument("--raw")
+            .default_value(false)
+            .implicit_value(true)
+            .help("Read headerless PCM from standard input instead of a sound file");
+    parser.add_argument("--raw_sr")
+            .default_value((int)(44100))
+            .help("Sample rate of raw input")
+            .scan<'i', int>();
+    parser.add_argument("--raw_channels")
+            .default_value((int)(1))
+            .help("Number of channels of raw input")
+            .scan<'i', int>();
+    parser.add_argument("--raw_format")
+            .default_value(std::string("s16"))
+            .help("Sample format of raw input: u8, s8, s16, s24, s32 or f32 (little endian)");
+    parser.add_argument("--state")
+            .default_value(std::string())
+            .help("State file for slicing a growing recording over several runs; each run only reads the newly appended audio");
+    parser.add_argument("--final")
+            .default_value(false)
+            .implicit_value(true)
+            .help("With --state: the recording is complete, so write the last clip and remove the state file");
+    parser.add_argument("--stats")
+            .default_value(false)
+            .implicit_value(true)
+            .help("Write a CSV file next to the clips with duration, peak, RMS, SNR, clipping and edge silence of each clip");
+    parser.add_argument("--perf")
+            .default_value(std::string())
+            .help("Write the time and hardware counters (cycles, instructions, cache and branch misses) of decoding, analysis and writing of every input to this CSV file; counters the system does not allow are left empty");
+    parser.add_argument("--normalize")
+            .default_value(std::string("none"))
+            .help("Normalize each clip: none, peak, rms or lufs (integrated loudness, ITU-R BS.1770)");
+    parser.add_argument("--target_db")
+            .help("Target level of --normalize, in dBFS or LUFS (default: -1 for peak, -20 for rms, -23 for lufs)")
+            .scan<'g', double>();
+    parser.add_argument("--out_sr")
+            .default_value((int)(0))
+            .help("Resample the clips to this sample rate (0 keeps the input rate)")
+            .scan<'i', int>();
+    parser.add_argument("--resample_quality")
+            .default_value((int)(2))
+            .help("Resampling quality from 0 (fastest) to 3 (best)")
+            .scan<'i', int>();
+    parser.add_argument("--pool_mb")
+            .default_value((uint64_t)(1024))
+            .help("Memory limit in MiB of the buffers that inputs are decoded into; they are reused across inputs")
+            .scan<'i', uint64_t>();
+    parser.add_argument("--decode_threads")
+            .default_value((unsigned int)(0))
+            .help("Threads decoding each FLAC or Ogg input, in ranges read through separate handles (0 for one per CPU)")
+            .scan<'i', unsigned int>();
+    parser.add_argument("--direct_io")
+            .default_value(false)
+            .implicit_value(true)
+            .help("Write clips past the page cache (O_DIRECT on Linux), for bulk jobs whose clips are not read again soon");
+    parser.add_argument("--whole_file")
+            .default_value(std::string("write"))
+            .help("When an input has no silence to cut, its single clip is the whole input: write it as usual, copy or link (hard link, or copy across file systems) the input, or skip it");
+    parser.add_argument("--shard")
+            .default_value(std::string())
+            .help("Slice only part i of N of the inputs, given as i/N with 0 <= i < N, so that N machines can share a batch; combine their manifests with 'audio_slicer_cli merge'");
+    parser.add_argument("--shard_root")
+            .default_value(std::string())
+            .help("Directory the inputs are named relative to for --shard and in manifests, the same on every machine (default: the current directory)");
+    parser.add_argument("--shard_balance")
+            .default_value(false)
+            .implicit_value(true)
+            .help("Balance the shards by file size instead of by path hash; every machine must then be given the same inputs");
+    parser.add_argument("--manifest")
+            .default_value(std::string())
+            .help("Write the inputs and the clips written for each to this file (default with --shard: manifest_<i>_of_<N>.txt in --out)");
+    parser.add_argument("--cache")
+            .default_value(std::string())
+            .help("Cache file recording finished inputs; inputs whose content and parameters are unchanged are skipped");
+    parser.add_argument("--journal")
+            .default_value(std::string())
+            .help("Journal file that every finished input is appended to as soon as it is done, so an interrupted batch can be resumed");
+    parser.add_argument("--resume")
+            .default_value(false)
+            .implicit_value(true)
+            .help("With --journal: skip the inputs the journal records as finished with the same parameters, and remove the partial clips of interrupted ones");
+    parser.add_argument("--overwrite_journal")
+            .default_value(false)
+            .implicit_value(true)
+            .help("With --journal: start a new journal even if the file already records a run");
+    parser.add_argument("--keep_order")
+            .default_value(false)
+            .implicit_value(true)
+            .help("Slice the inputs in the order given instead of in the order they are stored on disk");
 
     try {
         parser.parse_args(argc, argv);
@@ -51,60 +870,450 @@ int main(int argc, char **argv)
     }
 
     auto out_str = parser.get("--out");
-    auto filename = parser.get("audio");
+    auto filenames = parser.get<std::vector<std::string>>("audio");
     auto db_thresh = parser.get<double>("--db_thresh");
     auto min_length = parser.get<uint64_t>("--min_length");
     auto min_interval = parser.get<uint64_t>("--min_interval");
     auto hop_size = parser.get<uint64_t>("--hop_size");
     auto max_sil_kept = parser.get<uint64_t>("--max_sil_kept");
+    auto raw = parser.get<bool>("--raw");
+    auto state_str = parser.get("--state");
+    auto cache_str = parser.get("--cache");
+    auto journal_str = parser.get("--journal");
+    auto resume = parser.get<bool>("--resume");
+    auto overwrite_journal = parser.get<bool>("--overwrite_journal");
+    auto perf_str = parser.get("--perf");
+    BufferPool::shared().set_max_bytes((size_t)parser.get<uint64_t>("--pool_mb") << 20);
+    SliceOptions options {db_thresh, min_length, min_interval, hop_size, max_sil_kept, parser.get<uint64_t>("--max_length"),
+                          parser.get<bool>("--two_pass"), parser.get<bool>("--stats"), ClipTransform(),
+                          parser.get<bool>("--auto_threshold"), parser.get<double>("--noise_percentile"),
+                          parser.get<double>("--auto_offset"), parser.get<uint64_t>("--auto_window"), WholeFileMode::Write,
+                          ChannelMode::Mix, parser.get<unsigned int>("--decode_threads"), parser.get<bool>("--direct_io")};
+    if (options.decode_threads == 0)
+    {
+        options.decode_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    try
+    {
+        options.transform.gain_mode = parse_gain_mode(parser.get("--normalize"));
+    }
+    catch (const std::invalid_argument& err)
+    {
+        std::cerr << err.what() << '\n';
+        std::exit(1);
+    }
+    try
+    {
+        options.whole_file = parse_whole_file_mode(parser.get("--whole_file"));
+        options.channel_mode = parse_channel_mode(parser.get("--channel_mode"));
+    }
+    catch (const std::invalid_argument& err)
+    {
+        std::cerr << err.what() << '\n';
+        std::exit(1);
+    }
+    options.transform.target_db = parser.present<double>("--target_db").value_or(default_target_db(options.transform.gain_mode));
+    options.transform.target_sr = parser.get<int>("--out_sr");
+    options.transform.quality = parser.get<int>("--resample_quality");
 
-    auto path = std::filesystem::absolute(filename);
-    auto out = out_str.empty() ? path.parent_path() : std::filesystem::path(out_str);
-
-    SndfileHandle handle(path.string().data());
-    int channels = handle.channels();
-    int sr = handle.samplerate();
-    int format = handle.format();
-    auto frames = handle.frames();
-
-    auto total_size = frames * channels;
-    std::vector<float> audio = std::vector<float>(total_size);
-
-    handle.read(audio.data(), total_size);
-
-    Slicer slicer(sr, db_thresh, min_length, min_interval, hop_size, max_sil_kept);
-    auto chunks = slicer.slice(audio, (unsigned int)channels);
+    bool from_stdin = (std::find(filenames.begin(), filenames.end(), "-") != filenames.end());
+    if ((from_stdin || !state_str.empty()) && (filenames.size() != 1))
+    {
+        std::cerr << "Standard input and --state only work with a single input" << '\n';
+        std::exit(1);
+    }
+    if (raw && !from_stdin)
+    {
+        std::cerr << "--raw only works with standard input (-)" << '\n';
+        std::exit(1);
+    }
+    if (!raw && (parser.is_used("--raw_sr") || parser.is_used("--raw_channels") || parser.is_used("--raw_format")))
+    {
+        std::cerr << "--raw_sr, --raw_channels and --raw_format need --raw" << '\n';
+        std::exit(1);
+    }
+    if ((from_stdin || !state_str.empty()) && options.auto_threshold)
+    {
+        std::cerr << "--auto_threshold needs the whole input and cannot be used with standard input or --state" << '\n';
+        std::exit(1);
+    }
+    if ((from_stdin || !state_str.empty()) && (!parser.get("--shard").empty() || !parser.get("--manifest").empty()))
+    {
+        std::cerr << "--shard and --manifest only work with input files" << '\n';
+        std::exit(1);
+    }
+    if ((from_stdin || !state_str.empty()) && !journal_str.empty())
+    {
+        std::cerr << "--journal only works with input files" << '\n';
+        std::exit(1);
+    }
+    if ((from_stdin || !state_str.empty()) && !perf_str.empty())
+    {
+        std::cerr << "--perf only works with input files" << '\n';
+        std::exit(1);
+    }
+    if (resume && journal_str.empty())
+    {
+        std::cerr << "--resume needs --journal" << '\n';
+        std::exit(1);
+    }
+    if (overwrite_journal && (journal_str.empty() || resume))
+    {
+        std::cerr << "--overwrite_journal needs --journal and cannot be used with --resume" << '\n';
+        std::exit(1);
+    }
+    if (!journal_str.empty() && !resume && !overwrite_journal)
+    {
+        // Starting a new journal would throw away the record of the run it holds.
+        std::error_code ec;
+        auto journal_size = std::filesystem::file_size(journal_str, ec);
+        if (!ec && (journal_size > 0))
+        {
+            std::cerr << "Journal " << journal_str << " already exists; pass --resume to continue its run or --overwrite_journal to start over" << '\n';
+            std::exit(1);
+        }
+    }
+    if ((from_stdin || !state_str.empty()) && (options.max_length > 0))
+    {
+        std::cerr << "--max_length needs the whole input and cannot be used with standard input or --state" << '\n';
+        std::exit(1);
+    }
+    if ((from_stdin || !state_str.empty() || options.two_pass) && (options.channel_mode != ChannelMode::Mix))
+    {
+        std::cerr << "--channel_mode needs the whole input and cannot be used with standard input, --state or --two_pass" << '\n';
+        std::exit(1);
+    }
 
     try
     {
-        if (!std::filesystem::exists(out) && !out.has_parent_path())
+        auto out = std::filesystem::path(out_str);
+        if (!out_str.empty() && !std::filesystem::exists(out) && !out.has_parent_path())
         {
             std::filesystem::create_directories(out.string());
         }
     }
     catch (const std::filesystem::filesystem_error& err)
     {
-        std::cerr << "Cannot write to directory " << out.string() << ": " << err.what() << '\n';
+        std::cerr << "Cannot write to directory " << out_str << ": " << err.what() << '\n';
         std::exit(2);
     }
 
-    int idx = 0;
-    for (auto chunk : chunks)
+    if (from_stdin)
     {
-        auto begin_frame = std::get<0>(chunk) * channels;
-        auto end_frame = std::get<1>(chunk) * channels;
-        auto frame_count = (sf_count_t)(end_frame - begin_frame);
-        if ((begin_frame == end_frame) || (begin_frame > total_size) || (end_frame > total_size))
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        int raw_format = 0, raw_channels = 0, raw_sr = 0;
+        if (raw)
         {
-            continue;
+            try
+            {
+                raw_format = SF_FORMAT_RAW | SF_ENDIAN_LITTLE | parse_raw_format(parser.get("--raw_format"));
+            }
+            catch (const std::invalid_argument& err)
+            {
+                std::cerr << err.what() << '\n';
+                std::exit(1);
+            }
+            raw_channels = parser.get<int>("--raw_channels");
+            raw_sr = parser.get<int>("--raw_sr");
         }
-        std::stringstream ss;
-        ss << std::filesystem::path(filename).stem().string() << "_" << idx << ".wav";
-        std::filesystem::path out_file_path = out / ss.str();
-        SndfileHandle wf = SndfileHandle(out_file_path.string().data(), SFM_WRITE, format, channels, sr);
-        wf.write(audio.data() + begin_frame, frame_count);
-        idx++;
+        SndfileHandle handle(fileno(stdin), false, SFM_READ, raw_format, raw_channels, raw_sr);
+        if (handle.error())
+        {
+            std::cerr << "Cannot read standard input: " << handle.strError() << '\n';
+            std::exit(3);
+        }
+        // Clips are always written as WAV, keeping the sample format of the input.
+        int format = SF_FORMAT_WAV | (handle.format() & SF_FORMAT_SUBMASK);
+        auto out = out_str.empty() ? std::filesystem::current_path() : std::filesystem::path(out_str);
+        Slicer slicer(handle.samplerate(), db_thresh, min_length, min_interval, hop_size, max_sil_kept);
+        slice_stream(handle, slicer, out, "stdin", format);
+        return 0;
     }
 
-    return 0;
-}
\ No newline at end of file
+    if (!state_str.empty())
+    {
+        auto path = std::filesystem::absolute(filenames[0]);
+        auto out = out_str.empty() ? path.parent_path() : std::filesystem::path(out_str);
+        try
+        {
+            SndfileHandle handle(path.string().data());
+            Slicer slicer(handle.samplerate(), db_thresh, min_length, min_interval, hop_size, max_sil_kept);
+            slice_resumable(handle, slicer, out, path.stem().string(), std::filesystem::path(state_str), parser.get<bool>("--final"));
+        }
+        catch (const std::exception& err)
+        {
+            std::cerr << err.what() << '\n';
+            std::exit(3);
+        }
+        return 0;
+    }
+
+    std::unique_ptr<ResultCache> cache;
+    if (!cache_str.empty())
+    {
+        cache = std::make_unique<ResultCache>(std::filesystem::path(cache_str));
+    }
+
+    /*
+     * Inputs are named by their path relative to the shard root, so that every machine agrees on
+     * which shard each one belongs to without talking to the others.
+     */
+    ShardSpec shard {0, 1};
+    auto shard_root = std::filesystem::absolute(parser.get("--shard_root").empty() ?
+            std::filesystem::current_path() : std::filesystem::path(parser.get("--shard_root")));
+    std::vector<std::string> keys;
+    for (const auto& filename : filenames)
+    {
+        keys.push_back(shard_key(std::filesystem::absolute(filename), shard_root));
+    }
+    std::vector<size_t> selected(filenames.size());
+    std::iota(selected.begin(), selected.end(), (size_t)0);
+    if (!parser.get("--shard").empty())
+    {
+        try
+        {
+            shard = parse_shard_spec(parser.get("--shard"));
+        }
+        catch (const std::invalid_argument& err)
+        {
+            std::cerr << err.what() << '\n';
+            std::exit(1);
+        }
+        std::vector<uint64_t> sizes;
+        if (parser.get<bool>("--shard_balance"))
+        {
+            for (const auto& filename : filenames)
+            {
+                std::error_code ec;
+                auto size = std::filesystem::file_size(filename, ec);
+                sizes.push_back(ec ? 0 : (uint64_t)size);
+            }
+        }
+        selected = select_shard(keys, sizes, shard);
+    }
+    auto manifest_path = std::filesystem::path(parser.get("--manifest"));
+    if (manifest_path.empty() && (shard.count > 1))
+    {
+        manifest_path = (out_str.empty() ? std::filesystem::current_path() : std::filesystem::path(out_str)) /
+                ("manifest_" + std::to_string(shard.index) + "_of_" + std::to_string(shard.count) + ".txt");
+    }
+    Manifest manifest(shard);
+    auto manifest_saved = std::chrono::steady_clock::now();
+
+    std::unique_ptr<Journal> journal;
+    if (!journal_str.empty())
+    {
+        try
+        {
+            journal = std::make_unique<Journal>(std::filesystem::path(journal_str), resume);
+        }
+        catch (const std::runtime_error& err)
+        {
+            std::cerr << err.what() << '\n';
+            std::exit(2);
+        }
+    }
+    if (resume)
+    {
+        // Clips of the inputs that were being sliced when the last run stopped are incomplete.
+        std::set<std::filesystem::path> out_dirs;
+        for (size_t index : selected)
+        {
+            out_dirs.insert(out_str.empty() ? std::filesystem::absolute(filenames[index]).parent_path() : std::filesystem::absolute(out_str));
+        }
+        for (const auto& dir : out_dirs)
+        {
+            remove_partial_outputs(dir);
+        }
+    }
+
+    std::unique_ptr<PerfCounters> counters;
+    std::ofstream perf_os;
+    if (!perf_str.empty())
+    {
+        counters = std::make_unique<PerfCounters>();
+        if (!counters->available())
+        {
+            std::cerr << "Hardware counters are not available here, --perf only reports times" << '\n';
+        }
+        perf_os.open(perf_str, std::ios::trunc);
+        perf_os << "stage,seconds";
+        for (int i = 0; i < PERF_EVENT_COUNT; i++)
+        {
+            perf_os << ',' << perf_event_name((PerfEvent)i);
+        }
+        perf_os << ",input\n";
+    }
+
+    /*
+     * Inputs are read in the order they are stored, which keeps seeks short on disks and network
+     * file systems, and with hints that read the next ones ahead and drop the finished ones.
+     */
+    std::vector<std::filesystem::path> paths;
+    for (const auto& filename : filenames)
+    {
+        paths.push_back(std::filesystem::absolute(filename));
+    }
+    if (!parser.get<bool>("--keep_order"))
+    {
+        selected = locality_order(paths, selected);
+    }
+    // Inputs the journal or the cache already has are found first, so that only those to be sliced are read ahead.
+    int failed = 0;
+    std::vector<InputPlan> plans(selected.size(), InputPlan::Slice);
+    std::vector<std::vector<std::string>> known_outputs(selected.size());
+    std::vector<std::string> check_errors(selected.size());
+    std::vector<size_t> queue_positions(selected.size());
+    std::vector<std::filesystem::path> queue;
+    for (size_t position = 0; position < selected.size(); position++)
+    {
+        size_t index = selected[position];
+        const auto& path = paths[index];
+        auto out = out_str.empty() ? path.parent_path() : std::filesystem::absolute(out_str);
+        try
+        {
+            uint64_t params_hash = hash_options(options, out);
+            if (resume && journal->finished(path, params_hash, &known_outputs[position]))
+            {
+                plans[position] = InputPlan::Journaled;
+            }
+            else if (cache && cache->lookup(path, params_hash, &known_outputs[position]))
+            {
+                plans[position] = InputPlan::Cached;
+            }
+        }
+        catch (const std::exception& err)
+        {
+            // Reported below, in order with the other inputs.
+            check_errors[position] = err.what();
+            plans[position] = InputPlan::Failed;
+        }
+        if (plans[position] == InputPlan::Slice)
+        {
+            queue_positions[position] = queue.size();
+            queue.push_back(path);
+        }
+    }
+    ReadaheadHints readahead(std::move(queue));
+
+    for (size_t position = 0; position < selected.size(); position++)
+    {
+        size_t index = selected[position];
+        const auto& filename = filenames[index];
+        const auto& path = paths[index];
+        InputPlan plan = plans[position];
+        auto out = out_str.empty() ? path.parent_path() : std::filesystem::absolute(out_str);
+        std::vector<std::string> outputs = std::move(known_outputs[position]);
+        std::string status = "sliced";
+        if (plan == InputPlan::Slice)
+        {
+            readahead.begin(queue_positions[position]);
+        }
+        try
+        {
+            uint64_t params_hash = hash_options(options, out);
+            if (plan == InputPlan::Failed)
+            {
+                throw std::runtime_error(check_errors[position]);
+            }
+            if (plan == InputPlan::Journaled)
+            {
+                // Sliced by the interrupted run, which may not have saved its cache.
+                if (cache && !cache->lookup(path, params_hash))
+                {
+                    cache->store(path, params_hash, std::vector<std::filesystem::path>(outputs.begin(), outputs.end()));
+                }
+            }
+            else if (plan == InputPlan::Cached)
+            {
+                status = "cached";
+            }
+            else
+            {
+                StagePerf perf {};
+                auto written = slice_file(path, out, options, counters.get(), &perf);
+                if (counters)
+                {
+                    write_perf_rows(perf_os, keys[index], perf);
+                }
+                if (cache)
+                {
+                    cache->store(path, params_hash, written);
+                }
+                for (const auto& output : written)
+                {
+                    outputs.push_back(output.string());
+                }
+            }
+            // Inputs the journal already records are not appended again, so it does not grow with every resume.
+            if (journal && (plan != InputPlan::Journaled))
+            {
+                journal->record(path, params_hash, std::vector<std::filesystem::path>(outputs.begin(), outputs.end()));
+            }
+        }
+        catch (const std::exception& err)
+        {
+            std::cerr << filename << ": " << err.what() << '\n';
+            status = "failed";
+            outputs.clear();
+            failed++;
+        }
+        if (plan == InputPlan::Slice)
+        {
+            readahead.end(queue_positions[position]);
+        }
+        for (auto& output : outputs)
+        {
+            output = shard_key(std::filesystem::path(output), shard_root);
+        }
+        manifest.add(keys[index], status, std::move(outputs));
+        if (!manifest_path.empty() && (std::chrono::steady_clock::now() - manifest_saved >= MANIFEST_SAVE_INTERVAL))
+        {
+            try
+            {
+                manifest.save(manifest_path);
+            }
+            catch (const std::exception&)
+            {
+                // Reported by the save after the batch if the problem persists.
+            }
+            manifest_saved = std::chrono::steady_clock::now();
+        }
+    }
+
+    if (!manifest_path.empty())
+    {
+        try
+        {
+            manifest.save(manifest_path);
+        }
+        catch (const std::exception& err)
+        {
+            std::cerr << err.what() << '\n';
+            failed++;
+        }
+    }
+
+    if (counters && !perf_os.flush())
+    {
+        std::cerr << "Cannot write " << perf_str << '\n';
+        failed++;
+    }
+
+    if (cache)
+    {
+        try
+        {
+            cache->save();
+        }
+        catch (const std::exception& err)
+        {
+            std::cerr << err.what() << '\n';
+            failed++;
+        }
+    }
+
+    return (failed > 0) ? 3 : 0;
+}
@@ -0,0 +1,118 @@
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "perfcounters.h"
+
+const char *perf_event_name(PerfEvent event)
+{
+    switch (event)
+    {
+        case PerfEvent::Cycles:
+            return "cycles";
+        case PerfEvent::Instructions:
+            return "instructions";
+        case PerfEvent::CacheMisses:
+            return "cache_misses";
+        case PerfEvent::BranchMisses:
+            return "branch_misses";
+    }
+    return "";
+}
+
+PerfCounts PerfCounts::operator-(const PerfCounts& other) const
+{
+    PerfCounts difference {};
+    difference.seconds = this->seconds - other.seconds;
+    for (int i = 0; i < PERF_EVENT_COUNT; i++)
+    {
+        difference.available[i] = this->available[i] && other.available[i];
+        difference.events[i] = (difference.available[i] && (this->events[i] > other.events[i])) ? this->events[i] - other.events[i] : 0;
+    }
+    return difference;
+}
+
+#ifdef __linux__
+static int open_counter(PerfEvent event)
+{
+    static const uint64_t configs[PERF_EVENT_COUNT] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[(int)event];
+    // Threads started later are counted too; kernel time is left out, so perf_event_paranoid 2 suffices.
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+#endif
+
+PerfCounters::PerfCounters()
+        : start(std::chrono::steady_clock::now())
+{
+    for (int i = 0; i < PERF_EVENT_COUNT; i++)
+    {
+#ifdef __linux__
+        this->fds[i] = open_counter((PerfEvent)i);
+#else
+        this->fds[i] = -1;
+#endif
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+    for (int fd : this->fds)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+#endif
+}
+
+bool PerfCounters::available() const
+{
+    for (int fd : this->fds)
+    {
+        if (fd >= 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+PerfCounts PerfCounters::read() const
+{
+    PerfCounts counts {};
+    counts.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->start).count();
+#ifdef __linux__
+    for (int i = 0; i < PERF_EVENT_COUNT; i++)
+    {
+        uint64_t values[3];
+        if ((this->fds[i] < 0) || (::read(this->fds[i], values, sizeof(values)) != (ssize_t)sizeof(values)))
+        {
+            continue;
+        }
+        // values: count, time enabled, time running.
+        counts.available[i] = true;
+        counts.events[i] = (values[2] == 0) ? 0 :
+                ((values[2] < values[1]) ? (uint64_t)((double)values[0] * values[1] / values[2]) : values[0]);
+    }
+#endif
+    return counts;
+}
@@ -0,0 +1,53 @@
+#ifndef AUDIO_SLICER_PERFCOUNTERS_H
+#define AUDIO_SLICER_PERFCOUNTERS_H
+
+#include <chrono>
+#include <cstdint>
+
+enum class PerfEvent
+{
+    Cycles,
+    Instructions,
+    CacheMisses,
+    BranchMisses,
+};
+
+static constexpr int PERF_EVENT_COUNT = 4;
+
+// Short name of an event, as used in reports: cycles, instructions, cache_misses, branch_misses.
+const char *perf_event_name(PerfEvent event);
+
+// Time and hardware events of the counting threads; an event is only meaningful where it is available.
+struct PerfCounts {
+    double seconds;
+    uint64_t events[PERF_EVENT_COUNT];
+    bool available[PERF_EVENT_COUNT];
+
+    PerfCounts operator-(const PerfCounts& other) const;
+};
+
+/*
+ * User-space hardware counters (perf_event_open on Linux) of the thread that creates this
+ * object and of the threads it starts afterwards, which are counted once they have exited.
+ * Events the kernel or the hardware refuses, as in most unprivileged containers, and every
+ * event on other systems, are reported as unavailable; times are always counted. Counters that
+ * the kernel had to multiplex are scaled to the whole time they were enabled.
+ */
+class PerfCounters {
+private:
+    int fds[PERF_EVENT_COUNT];
+    std::chrono::steady_clock::time_point start;
+
+public:
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Whether any hardware event is counted.
+    bool available() const;
+    // Totals since construction; subtract two readings for the counts in between.
+    PerfCounts read() const;
+};
+
+#endif //AUDIO_SLICER_PERFCOUNTERS_H
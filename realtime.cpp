@@ -0,0 +1,241 @@
+#include <stdexcept>
+
+#include "realtime.h"
+
+RealtimeSlicer::RealtimeSlicer(const Slicer& slicer, unsigned int channels, uint64_t max_block_frames, uint64_t buffer_frames,
+                               size_t event_count)
+        : stream(slicer),
+          channels(channels),
+          max_block_frames(max_block_frames),
+          hop_size(slicer.get_hop_size()),
+          audio((size_t)(buffer_frames * channels)),
+          events(event_count),
+          frames(0),
+          released(0),
+          release_sent(0),
+          finished(false),
+          has_gap(false),
+          gap_begin(0),
+          lost(0)
+{
+    if (channels == 0)
+    {
+        throw std::invalid_argument("The number of channels must be positive");
+    }
+    if ((max_block_frames == 0) || (buffer_frames < max_block_frames))
+    {
+        throw std::invalid_argument("The audio buffer must hold at least one block");
+    }
+    if (event_count < 4)
+    {
+        throw std::invalid_argument("The event buffer must hold at least 4 events");
+    }
+    /*
+     * Every RMS value decides at most one chunk. A block completes at most one value per hop plus
+     * the one left by the envelope's constructor, and finish() at most three more plus the last chunk.
+     */
+    this->chunks.reserve(max_block_frames / this->hop_size + 8);
+}
+
+bool RealtimeSlicer::push_chunks() noexcept
+{
+    /*
+     * While a gap is not announced, the writer must not be sent anything that makes it read audio
+     * past the start of the gap, so the chunks are lost like those that find the ring full.
+     */
+    bool ok = true;
+    for (const auto& chunk : this->chunks)
+    {
+        if (this->has_gap || !this->events.push({RealtimeEventType::Chunk, std::get<0>(chunk), std::get<1>(chunk)}))
+        {
+            this->lost.fetch_add(1, std::memory_order_relaxed);
+            ok = false;
+        }
+    }
+    this->chunks.clear();
+    return ok;
+}
+
+RealtimeStatus RealtimeSlicer::process(const float *block, uint64_t frames) noexcept
+{
+    if (this->finished.load(std::memory_order_relaxed) || (frames > this->max_block_frames))
+    {
+        return RealtimeStatus::Rejected;
+    }
+    bool ok = true;
+
+    /*
+     * Audio of a gap must be announced before any audio after it, or the writer would put that
+     * audio in the wrong place. Until the Dropped event fits, the gap keeps growing.
+     */
+    if (this->has_gap && this->events.push({RealtimeEventType::Dropped, this->gap_begin, this->frames}))
+    {
+        this->has_gap = false;
+    }
+    uint64_t written = this->has_gap ? 0 : std::min(frames, (uint64_t)(this->audio.write_space() / this->channels));
+    this->audio.write(block, (size_t)(written * this->channels));
+    if (written < frames)
+    {
+        if (!this->has_gap)
+        {
+            this->has_gap = true;
+            this->gap_begin = this->frames + written;
+        }
+        if (this->events.push({RealtimeEventType::Dropped, this->gap_begin, this->frames + frames}))
+        {
+            this->has_gap = false;
+        }
+        ok = false;
+    }
+    this->frames += frames;
+
+    // The chunk list has room for a whole block, so analysis never allocates.
+    this->stream.feed_into(block, frames, this->channels, this->chunks);
+    ok = push_chunks() && ok;
+
+    // Frames of the open chunk are decided, but still needed by the writer.
+    uint64_t release = this->stream.committed();
+    if (this->stream.has_open_chunk())
+    {
+        release = std::min(release, this->stream.open_chunk_begin());
+    }
+    this->released = std::max(this->released, release);
+    /*
+     * At most one Release per hop, so that tiny blocks do not fill the event ring. A lost Release
+     * only delays the writer reading audio and freeing memory; the next one catches up.
+     */
+    if (!this->has_gap && (this->frames - this->release_sent >= this->hop_size) &&
+        this->events.push({RealtimeEventType::Release, this->released, this->frames}))
+    {
+        this->release_sent = this->frames;
+    }
+    return ok ? RealtimeStatus::Ok : RealtimeStatus::Overrun;
+}
+
+RealtimeStatus RealtimeSlicer::finish() noexcept
+{
+    if (this->finished.load(std::memory_order_relaxed))
+    {
+        return RealtimeStatus::Rejected;
+    }
+    if (this->has_gap && this->events.push({RealtimeEventType::Dropped, this->gap_begin, this->frames}))
+    {
+        this->has_gap = false;
+    }
+    this->stream.finish_into(this->chunks);
+    bool ok = push_chunks() && !this->has_gap;
+    if (!this->has_gap && (this->release_sent < this->frames) &&
+        !this->events.push({RealtimeEventType::Release, this->frames, this->frames}))
+    {
+        ok = false;
+    }
+    // Published after the last event, so a writer that sees it can drain the ring and stop.
+    this->finished.store(true, std::memory_order_release);
+    return ok ? RealtimeStatus::Ok : RealtimeStatus::Overrun;
+}
+
+bool RealtimeSlicer::pop_event(RealtimeEvent& event) noexcept
+{
+    return this->events.pop(event);
+}
+
+uint64_t RealtimeSlicer::read_audio(float *samples, uint64_t frames) noexcept
+{
+    // Audio is written in whole frames, so whole frames are always available.
+    return this->audio.read(samples, (size_t)(frames * this->channels)) / this->channels;
+}
+
+bool RealtimeSlicer::ended() const noexcept
+{
+    return this->finished.load(std::memory_order_acquire);
+}
+
+uint64_t RealtimeSlicer::lost_chunks() const noexcept
+{
+    return this->lost.load(std::memory_order_relaxed);
+}
+
+unsigned int RealtimeSlicer::get_channels() const noexcept
+{
+    return this->channels;
+}
+
+RealtimeClipReader::RealtimeClipReader(RealtimeSlicer& source)
+        : source(source),
+          history_begin(0),
+          is_finished(false)
+{}
+
+void RealtimeClipReader::receive(uint64_t until)
+{
+    unsigned int channels = this->source.get_channels();
+    uint64_t received = this->history_begin + this->history.size() / channels;
+    if (until <= received)
+    {
+        return;
+    }
+    size_t size = this->history.size();
+    this->history.resize(size + (size_t)((until - received) * channels));
+    uint64_t read = this->source.read_audio(this->history.data() + size, until - received);
+    // Short only if the audio was dropped; the Dropped event that follows fills it in.
+    this->history.resize(size + (size_t)(read * channels));
+}
+
+void RealtimeClipReader::release(uint64_t until)
+{
+    unsigned int channels = this->source.get_channels();
+    if (until <= this->history_begin)
+    {
+        return;
+    }
+    auto frames = (size_t)std::min(until - this->history_begin, (uint64_t)(this->history.size() / channels));
+    this->history.erase(this->history.begin(), this->history.begin() + (ptrdiff_t)(frames * channels));
+    this->history_begin += frames;
+}
+
+bool RealtimeClipReader::next_clip(std::vector<float>& clip, uint64_t& begin, uint64_t& end)
+{
+    // Audio is only read up to positions the events have covered, so a gap is always seen before the audio after it.
+    unsigned int channels = this->source.get_channels();
+    bool ended = this->source.ended();
+    RealtimeEvent event {};
+    while (this->source.pop_event(event))
+    {
+        switch (event.type)
+        {
+            case RealtimeEventType::Chunk:
+            {
+                receive(event.end);
+                begin = event.begin;
+                end = event.end;
+                clip.assign((size_t)((end - begin) * channels), 0.0f);
+                uint64_t available_end = this->history_begin + this->history.size() / channels;
+                uint64_t first = std::max(begin, this->history_begin);
+                uint64_t last = std::min(end, available_end);
+                if (first < last)
+                {
+                    std::copy(this->history.begin() + (ptrdiff_t)((first - this->history_begin) * channels),
+                              this->history.begin() + (ptrdiff_t)((last - this->history_begin) * channels),
+                              clip.begin() + (ptrdiff_t)((first - begin) * channels));
+                }
+                return true;
+            }
+            case RealtimeEventType::Release:
+                receive(event.end);
+                release(event.begin);
+                break;
+            case RealtimeEventType::Dropped:
+                receive(event.begin);
+                this->history.resize(this->history.size() + (size_t)((event.end - event.begin) * channels), 0.0f);
+                break;
+        }
+    }
+    // Once the stream had ended before the ring was drained, nothing more can come.
+    this->is_finished = ended;
+    return false;
+}
+
+bool RealtimeClipReader::finished() const
+{
+    return this->is_finished;
+}
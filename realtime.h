@@ -0,0 +1,215 @@
+#ifndef AUDIO_SLICER_REALTIME_H
+#define AUDIO_SLICER_REALTIME_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "slicer.h"
+
+/*
+ * Ring buffer for exactly one producer thread and one consumer thread. Neither side locks,
+ * blocks or allocates: writes and reads simply transfer fewer items when the ring is full or
+ * empty. The capacity is rounded up to a power of two.
+ */
+template<class T>
+class SpscRing {
+    static_assert(std::is_trivially_copyable<T>::value, "SpscRing items are copied as plain memory");
+
+private:
+    std::unique_ptr<T[]> items;
+    size_t mask;
+    // Positions only ever grow; each is written by one side and read by the other.
+    alignas(64) std::atomic<size_t> read_pos;
+    alignas(64) std::atomic<size_t> write_pos;
+
+public:
+    explicit SpscRing(size_t capacity)
+            : mask(0),
+              read_pos(0),
+              write_pos(0)
+    {
+        size_t size = 1;
+        while (size < capacity)
+        {
+            size *= 2;
+        }
+        this->items.reset(new T[size]);
+        this->mask = size - 1;
+    }
+
+    size_t capacity() const noexcept
+    {
+        return this->mask + 1;
+    }
+
+    // Items that can be written now. Only meaningful on the producer thread.
+    size_t write_space() const noexcept
+    {
+        return capacity() - (this->write_pos.load(std::memory_order_relaxed) - this->read_pos.load(std::memory_order_acquire));
+    }
+
+    // Items that can be read now. Only meaningful on the consumer thread.
+    size_t read_space() const noexcept
+    {
+        return this->write_pos.load(std::memory_order_acquire) - this->read_pos.load(std::memory_order_relaxed);
+    }
+
+    // Producer side: copies up to count items in, returning how many fitted.
+    size_t write(const T *values, size_t count) noexcept
+    {
+        size_t pos = this->write_pos.load(std::memory_order_relaxed);
+        size_t n = std::min(count, write_space());
+        size_t first = std::min(n, capacity() - (pos & this->mask));
+        std::copy(values, values + first, this->items.get() + (pos & this->mask));
+        std::copy(values + first, values + n, this->items.get());
+        this->write_pos.store(pos + n, std::memory_order_release);
+        return n;
+    }
+
+    // Consumer side: copies up to count items out, returning how many there were.
+    size_t read(T *values, size_t count) noexcept
+    {
+        size_t pos = this->read_pos.load(std::memory_order_relaxed);
+        size_t n = std::min(count, read_space());
+        size_t first = std::min(n, capacity() - (pos & this->mask));
+        std::copy(this->items.get() + (pos & this->mask), this->items.get() + (pos & this->mask) + first, values);
+        std::copy(this->items.get(), this->items.get() + (n - first), values + first);
+        this->read_pos.store(pos + n, std::memory_order_release);
+        return n;
+    }
+
+    bool push(const T& value) noexcept
+    {
+        return write(&value, 1) == 1;
+    }
+
+    bool pop(T& value) noexcept
+    {
+        return read(&value, 1) == 1;
+    }
+};
+
+/*
+ * What RealtimeSlicer tells the writer thread, in stream order. Positions are in frames.
+ * Chunk: a clip from begin to end.
+ * Release: no later chunk contains a frame before begin; end is the number of frames fed so far.
+ * Dropped: the frames from begin to end were lost because the audio ring was full.
+ */
+enum class RealtimeEventType {
+    Chunk,
+    Release,
+    Dropped
+};
+
+struct RealtimeEvent {
+    RealtimeEventType type;
+    uint64_t begin;
+    uint64_t end;
+};
+
+enum class RealtimeStatus {
+    Ok,
+    // The block was analyzed, but audio or chunks could not be handed over because the writer fell behind.
+    Overrun,
+    // Nothing was done: the block was larger than the maximum, or the stream was already finished.
+    Rejected
+};
+
+/*
+ * StreamSlicer for an audio callback that must never allocate, lock or throw. All memory is
+ * allocated by the constructor (which throws like StreamSlicer's for unsupported slicer
+ * options): the RMS window, the max_sil_kept + 1 hops the boundary search looks at, the chunk
+ * list of one block, and two lock-free rings through which the audio and the events of
+ * RealtimeEventType reach a writer thread. process() and finish() are meant for the audio
+ * thread, pop_event() and read_audio() for the writer thread, usually through
+ * RealtimeClipReader. The chunks are those StreamSlicer returns for the same blocks.
+ *
+ * Worst-case cost of process() for a block of B frames of C channels: the block is copied into
+ * the audio ring and downmixed once, O(B * C); then every hop completed by the block costs
+ * O(1), except a hop that decides a boundary, which searches at most 3 * (max_sil_kept + 1)
+ * RMS values. Apart from the leading silence, boundaries are decided at most twice every
+ * min_length hops, so a block decides at most 2 * (B / (min_length * hop_size) + 2) of them.
+ * At most one event per chunk plus two per block or hop, whichever is longer, are pushed.
+ * finish() additionally completes the last half RMS window, at most two hops.
+ */
+class RealtimeSlicer {
+private:
+    StreamSlicer stream;
+    unsigned int channels;
+    uint64_t max_block_frames;
+    uint64_t hop_size;
+
+    std::vector<std::tuple<uint64_t, uint64_t>> chunks;
+    SpscRing<float> audio;
+    SpscRing<RealtimeEvent> events;
+
+    uint64_t frames;
+    uint64_t released;
+    // Frames fed when the last Release was sent.
+    uint64_t release_sent;
+    std::atomic<bool> finished;
+    // Frames lost since gap_begin whose Dropped event has not fitted into the ring yet.
+    bool has_gap;
+    uint64_t gap_begin;
+    std::atomic<uint64_t> lost;
+
+    bool push_chunks() noexcept;
+
+public:
+    /*
+     * The audio ring holds buffer_frames frames, which must be at least one block; it has to
+     * cover the time the writer thread may take to get to it. The event ring holds event_count
+     * events.
+     */
+    RealtimeSlicer(const Slicer& slicer, unsigned int channels, uint64_t max_block_frames, uint64_t buffer_frames,
+                   size_t event_count = 4096);
+    RealtimeSlicer(const RealtimeSlicer&) = delete;
+    RealtimeSlicer& operator=(const RealtimeSlicer&) = delete;
+
+    // Audio thread: analyzes a block of at most max_block_frames interleaved frames.
+    RealtimeStatus process(const float *block, uint64_t frames) noexcept;
+    // Audio thread: decides the remaining chunks and ends the stream.
+    RealtimeStatus finish() noexcept;
+
+    // Writer thread.
+    bool pop_event(RealtimeEvent& event) noexcept;
+    uint64_t read_audio(float *samples, uint64_t frames) noexcept;
+    // Whether finish() has been called; every event has then been pushed.
+    bool ended() const noexcept;
+    // Chunk events that did not fit into the event ring, and are lost for good.
+    uint64_t lost_chunks() const noexcept;
+    unsigned int get_channels() const noexcept;
+};
+
+/*
+ * Writer side of a RealtimeSlicer: follows its events and audio, keeps the audio that may
+ * still belong to a clip, and assembles each clip once its chunk arrives. Frames lost to an
+ * overrun read as silence. It allocates, so it must not run on the audio thread; call
+ * next_clip() often enough for the audio ring not to fill up.
+ */
+class RealtimeClipReader {
+private:
+    RealtimeSlicer& source;
+    // Interleaved frames from history_begin on.
+    std::vector<float> history;
+    uint64_t history_begin;
+    bool is_finished;
+
+    void receive(uint64_t until);
+    void release(uint64_t until);
+
+public:
+    explicit RealtimeClipReader(RealtimeSlicer& source);
+    // Returns true with the next clip and its position, or false when there is none yet.
+    bool next_clip(std::vector<float>& clip, uint64_t& begin, uint64_t& end);
+    // Whether the stream has ended and every clip has been returned.
+    bool finished() const;
+};
+
+#endif //AUDIO_SLICER_REALTIME_H
@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <numeric>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "shard.h"
+#include "fields.h"
+#include "hash.h"
+
+// First line of a manifest file, bumped whenever the layout changes.
+static const char MANIFEST_HEADER[] = "audio_slicer manifest 2";
+
+ShardSpec parse_shard_spec(const std::string& spec)
+{
+    auto slash = spec.find('/');
+    // At most nine digits on each side, so that the numbers always fit.
+    if ((slash == std::string::npos) || (slash == 0) || (slash > 9) || (slash + 1 == spec.size()) || (spec.size() - slash - 1 > 9) ||
+        (spec.find_first_not_of("0123456789/") != std::string::npos) || (spec.find('/', slash + 1) != std::string::npos))
+    {
+        throw std::invalid_argument("Shard must be given as i/N: " + spec);
+    }
+    unsigned long index = std::stoul(spec.substr(0, slash));
+    unsigned long count = std::stoul(spec.substr(slash + 1));
+    if ((count == 0) || (index >= count))
+    {
+        throw std::invalid_argument("Shard index must satisfy 0 <= i < N: " + spec);
+    }
+    return {(unsigned int)index, (unsigned int)count};
+}
+
+std::string shard_key(const std::filesystem::path& input, const std::filesystem::path& root)
+{
+    auto relative = input.lexically_normal().lexically_relative(root.lexically_normal());
+    return (relative.empty() ? input.lexically_normal() : relative).generic_string();
+}
+
+std::vector<size_t> select_shard(const std::vector<std::string>& keys, const std::vector<uint64_t>& sizes, ShardSpec spec)
+{
+    std::vector<size_t> selected;
+    if (sizes.empty())
+    {
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            if (hash_string(keys[i]) % spec.count == spec.index)
+            {
+                selected.push_back(i);
+            }
+        }
+        return selected;
+    }
+
+    // Largest first, ties broken by key, so that every machine deals the inputs in the same order.
+    std::vector<size_t> order(keys.size());
+    std::iota(order.begin(), order.end(), (size_t)0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b)
+    {
+        return (sizes[a] != sizes[b]) ? (sizes[a] > sizes[b]) : (keys[a] < keys[b]);
+    });
+    using Load = std::pair<uint64_t, unsigned int>;
+    std::priority_queue<Load, std::vector<Load>, std::greater<Load>> loads;
+    for (unsigned int shard = 0; shard < spec.count; shard++)
+    {
+        loads.emplace(0, shard);
+    }
+    for (size_t i : order)
+    {
+        Load lightest = loads.top();
+        loads.pop();
+        if (lightest.second == spec.index)
+        {
+            selected.push_back(i);
+        }
+        loads.emplace(lightest.first + sizes[i], lightest.second);
+    }
+    std::sort(selected.begin(), selected.end());
+    return selected;
+}
+
+Manifest::Manifest(ShardSpec shard)
+        : shard(shard)
+{}
+
+void Manifest::add(std::string input, std::string status, std::vector<std::string> outputs)
+{
+    this->entries.push_back({std::move(input), std::move(status), std::move(outputs)});
+}
+
+ShardSpec Manifest::get_shard() const
+{
+    return this->shard;
+}
+
+const std::vector<Manifest::Entry>& Manifest::get_entries() const
+{
+    return this->entries;
+}
+
+void Manifest::save(const std::filesystem::path& path) const
+{
+    /*
+     * The header, then the shard as "index count", then one line per input: key, status,
+     * number of outputs and the outputs, separated by tabs, with the paths escaped by
+     * escape_field.
+     */
+    auto tmp_path = path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream os(tmp_path, std::ios::trunc);
+        os << MANIFEST_HEADER << '\n';
+        os << "shard " << this->shard.index << ' ' << this->shard.count << '\n';
+        for (const auto& entry : this->entries)
+        {
+            os << escape_field(entry.input) << '\t' << entry.status << '\t' << entry.outputs.size();
+            for (const auto& output : entry.outputs)
+            {
+                os << '\t' << escape_field(output);
+            }
+            os << '\n';
+        }
+        if (!os.flush())
+        {
+            throw std::runtime_error("Cannot write manifest " + tmp_path.string());
+        }
+    }
+    std::filesystem::rename(tmp_path, path);
+}
+
+Manifest Manifest::load(const std::filesystem::path& path)
+{
+    std::ifstream is(path);
+    std::string line;
+    if (!std::getline(is, line) || (line != MANIFEST_HEADER))
+    {
+        throw std::runtime_error("Not a manifest: " + path.string());
+    }
+    std::string word;
+    ShardSpec shard {};
+    if (!std::getline(is, line) || !(std::stringstream(line) >> word >> shard.index >> shard.count) ||
+        (word != "shard") || (shard.index >= shard.count))
+    {
+        throw std::runtime_error("Invalid shard line in manifest " + path.string());
+    }
+
+    Manifest manifest(shard);
+    while (std::getline(is, line))
+    {
+        std::stringstream ss(line);
+        Entry entry;
+        std::string count_field, field;
+        if (!std::getline(ss, entry.input, '\t') || !std::getline(ss, entry.status, '\t') || !std::getline(ss, count_field, '\t') ||
+            (count_field.empty()) || (count_field.find_first_not_of("0123456789") != std::string::npos))
+        {
+            throw std::runtime_error("Invalid entry in manifest " + path.string() + ": " + line);
+        }
+        size_t output_count = std::stoul(count_field);
+        entry.input = unescape_field(entry.input);
+        while (std::getline(ss, field, '\t'))
+        {
+            entry.outputs.push_back(unescape_field(field));
+        }
+        if (entry.outputs.size() != output_count)
+        {
+            throw std::runtime_error("Invalid entry in manifest " + path.string() + ": " + line);
+        }
+        manifest.entries.push_back(std::move(entry));
+    }
+    return manifest;
+}
+
+Manifest Manifest::merge(const std::vector<Manifest>& shards)
+{
+    if (shards.empty())
+    {
+        throw std::runtime_error("No manifests to merge");
+    }
+    unsigned int count = shards[0].shard.count;
+    std::vector<bool> seen(count, false);
+    for (const auto& manifest : shards)
+    {
+        if (manifest.shard.count != count)
+        {
+            throw std::runtime_error("Manifests of different shard counts: " + std::to_string(count) +
+                                     " and " + std::to_string(manifest.shard.count));
+        }
+        if (seen[manifest.shard.index])
+        {
+            throw std::runtime_error("Shard " + std::to_string(manifest.shard.index) + "/" + std::to_string(count) + " given twice");
+        }
+        seen[manifest.shard.index] = true;
+    }
+    std::string missing;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (!seen[i])
+        {
+            missing += (missing.empty() ? "" : ", ") + std::to_string(i);
+        }
+    }
+    if (!missing.empty())
+    {
+        throw std::runtime_error("Missing shards: " + missing);
+    }
+
+    Manifest merged;
+    std::unordered_set<std::string> inputs;
+    for (const auto& manifest : shards)
+    {
+        for (const auto& entry : manifest.entries)
+        {
+            // Only possible if the shards were run on different lists of inputs.
+            if (!inputs.insert(entry.input).second)
+            {
+                throw std::runtime_error("Input in several shards: " + entry.input);
+            }
+            merged.entries.push_back(entry);
+        }
+    }
+    std::sort(merged.entries.begin(), merged.entries.end(), [](const Entry& a, const Entry& b)
+    {
+        return a.input < b.input;
+    });
+    return merged;
+}
@@ -0,0 +1,58 @@
+#ifndef AUDIO_SLICER_SHARD_H
+#define AUDIO_SLICER_SHARD_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+// Part index of count parts of a batch, 0 <= index < count.
+struct ShardSpec {
+    unsigned int index;
+    unsigned int count;
+};
+
+// Parses "i/N"; throws std::invalid_argument if it is malformed or i >= N.
+ShardSpec parse_shard_spec(const std::string& spec);
+
+// Name of an input that is the same on every machine: its path relative to root, with forward slashes.
+std::string shard_key(const std::filesystem::path& input, const std::filesystem::path& root);
+
+/*
+ * Indices of the inputs that belong to a shard. Without sizes, an input goes to the shard given
+ * by the hash of its key, so adding or removing inputs never moves the others. With sizes (one
+ * per key), the inputs are dealt largest first to the least loaded shard, which balances the
+ * bytes per shard but needs every machine to see the same inputs.
+ */
+std::vector<size_t> select_shard(const std::vector<std::string>& keys, const std::vector<uint64_t>& sizes, ShardSpec spec);
+
+/*
+ * The inputs of a batch run, what happened to each and the files written for it. Every shard
+ * writes its own manifest; merge() combines the manifests of all shards into one index of the
+ * whole corpus, which is a manifest of shard 0/1.
+ */
+class Manifest {
+public:
+    struct Entry {
+        std::string input;
+        std::string status;
+        std::vector<std::string> outputs;
+    };
+
+private:
+    ShardSpec shard;
+    std::vector<Entry> entries;
+
+public:
+    explicit Manifest(ShardSpec shard = {0, 1});
+    void add(std::string input, std::string status, std::vector<std::string> outputs);
+    ShardSpec get_shard() const;
+    const std::vector<Entry>& get_entries() const;
+    void save(const std::filesystem::path& path) const;
+    // Throws std::runtime_error if the file cannot be read or is not a manifest.
+    static Manifest load(const std::filesystem::path& path);
+    // Throws std::runtime_error if shards are missing, repeated or overlap.
+    static Manifest merge(const std::vector<Manifest>& shards);
+};
+
+#endif //AUDIO_SLICER_SHARD_H
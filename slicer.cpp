@@ -4,8 +4,10 @@
 #include <stdexcept>
 #include <algorithm>
 #include <iostream>
+#include <cstring>
 
 #include "slicer.h"
+#include "basicslicer.h"
 
 template<class T>
 inline T divIntRound(T n, T d);
@@ -13,11 +15,112 @@ inline T divIntRound(T n, T d);
 template<class T>
 inline uint64_t argmin_range_view(const std::vector<T>& v, uint64_t begin, uint64_t end);
 
+template<class Sample, class Accumulator>
+inline std::vector<double> envelope_of(const Sample *waveform, uint64_t frames, unsigned int channels, ChannelMode mode,
+                                       uint64_t frame_length, uint64_t hop_length, RmsHistogram *histogram);
+
+template<class T>
+inline void write_state(std::ostream& os, const T& value);
+
+template<class T>
+inline void read_state(std::istream& is, T& value);
+
 template<class T>
-inline std::vector<T> multichannel_to_mono(const std::vector<T>& v, unsigned int channels);
+inline void write_state_vector(std::ostream& os, const std::vector<T>& v);
 
 template<class T>
-inline std::vector<double> get_rms(const std::vector<T>& arr, uint64_t frame_length = 2048, uint64_t hop_length = 512);
+inline void read_state_vector(std::istream& is, std::vector<T>& v);
+
+/*
+ * Answers "index of the first minimum in [begin, end)" in constant time after linear-ish setup:
+ * minima of fixed blocks go into a sparse table, and only the partial blocks at both ends of a
+ * query are scanned. The table has (n / BLOCK) * log(n / BLOCK) entries, so it stays small even
+ * for an envelope of many hours.
+ */
+class RangeMinimum {
+private:
+    static constexpr uint64_t BLOCK = 32;
+
+    const std::vector<double>& values;
+    // table[level][i]: index of the minimum of blocks i .. i + 2^level - 1.
+    std::vector<std::vector<uint64_t>> table;
+
+    uint64_t better(uint64_t a, uint64_t b) const
+    {
+        return (this->values[b] < this->values[a]) ? b : a;
+    }
+
+    uint64_t scan(uint64_t begin, uint64_t end) const
+    {
+        uint64_t best = begin;
+        for (uint64_t i = begin + 1; i < end; i++)
+        {
+            if (this->values[i] < this->values[best])
+            {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+public:
+    explicit RangeMinimum(const std::vector<double>& values)
+            : values(values)
+    {
+        uint64_t blocks = (values.size() + BLOCK - 1) / BLOCK;
+        if (blocks == 0)
+        {
+            return;
+        }
+        this->table.emplace_back(blocks);
+        for (uint64_t i = 0; i < blocks; i++)
+        {
+            this->table[0][i] = scan(i * BLOCK, std::min((i + 1) * BLOCK, (uint64_t)values.size()));
+        }
+        for (uint64_t level = 1; ((uint64_t)1 << level) <= blocks; level++)
+        {
+            uint64_t span = (uint64_t)1 << (level - 1);
+            const auto& previous = this->table[level - 1];
+            std::vector<uint64_t> current(blocks - 2 * span + 1);
+            for (uint64_t i = 0; i < current.size(); i++)
+            {
+                current[i] = better(previous[i], previous[i + span]);
+            }
+            this->table.push_back(std::move(current));
+        }
+    }
+
+    uint64_t query(uint64_t begin, uint64_t end) const
+    {
+        uint64_t first_block = (begin + BLOCK - 1) / BLOCK;
+        uint64_t last_block = end / BLOCK;
+        if (first_block >= last_block)
+        {
+            return scan(begin, end);
+        }
+
+        uint64_t best = (begin < first_block * BLOCK) ? scan(begin, first_block * BLOCK) : begin;
+        uint64_t count = last_block - first_block;
+        uint64_t level = 0;
+        while (((uint64_t)2 << level) <= count)
+        {
+            level++;
+        }
+        best = better(best, this->table[level][first_block]);
+        best = better(best, this->table[level][last_block - ((uint64_t)1 << level)]);
+        if (last_block * BLOCK < end)
+        {
+            best = better(best, scan(last_block * BLOCK, end));
+        }
+        return best;
+    }
+};
+
+// Samples at or above this magnitude count as clipped; 16-bit full scale is 32767 / 32768.
+static const float CLIP_LEVEL = 0.999f;
+
+// Identifies a saved StreamSlicer state, and its layout version.
+static const char STATE_MAGIC[8] = {'A', 'S', 'S', 'T', 'A', 'T', 'E', '1'};
 
 
 Slicer::Slicer(int sr, double threshold, uint64_t min_length, uint64_t min_interval, uint64_t hop_size, uint64_t max_sil_kept)
@@ -32,6 +135,14 @@ Slicer::Slicer(int sr, double threshold, uint64_t min_length, uint64_t min_inter
     }
 
     this->threshold = std::pow(10, threshold / 20.0);
+    this->max_length = 0;
+    this->channel_mode = ChannelMode::Mix;
+    this->sample_rate = sr;
+    this->auto_threshold = false;
+    this->auto_percentile = 0;
+    this->auto_offset_db = 0;
+    this->auto_window = 0;
+    this->single_precision = false;
     this->hop_size = divIntRound<uint64_t>(hop_size * (uint64_t)sr, (uint64_t)1000);
     this->win_size = std::min(divIntRound<uint64_t>(min_interval * (uint64_t)sr, (uint64_t)1000), (uint64_t)4 * this->hop_size);
     this->min_length = divIntRound<uint64_t>(min_length * (uint64_t)sr, (uint64_t)1000 * this->hop_size);
@@ -42,16 +153,303 @@ Slicer::Slicer(int sr, double threshold, uint64_t min_length, uint64_t min_inter
 std::vector<std::tuple<uint64_t, uint64_t>>
 Slicer::slice(const std::vector<float>& waveform, unsigned int channels)
 {
-    uint64_t frames = waveform.size() / channels;
-    std::vector<float> samples = multichannel_to_mono<float>(waveform, channels);
+    return slice(waveform.data(), waveform.size(), channels);
+}
+
+std::vector<std::tuple<uint64_t, uint64_t>>
+Slicer::slice(const std::vector<float>& waveform, unsigned int channels, std::vector<ChunkStats>& stats)
+{
+    return slice(waveform.data(), waveform.size(), channels, stats);
+}
+
+std::vector<std::tuple<uint64_t, uint64_t>>
+Slicer::slice(const float *waveform, uint64_t samples_count, unsigned int channels)
+{
+    uint64_t frames = samples_count / channels;
+    if (frames <= this->min_length)
+    {
+        std::vector<std::tuple<uint64_t, uint64_t>> v {{ 0, frames }};
+        return v;
+    }
+
+    RmsHistogram histogram(this->auto_window);
+    RmsHistogram *levels = this->auto_threshold ? &histogram : nullptr;
+    bool per_channel = (this->channel_mode != ChannelMode::Mix) && (channels > 1);
+
+    // The automatic threshold is only known after the full analysis, and splitting needs the envelope.
+    if (!per_channel && !this->auto_threshold && ((this->max_length == 0) || (frames <= this->max_length * this->hop_size)))
+    {
+        WaveformClass waveform_class = classify(waveform, samples_count, channels);
+        if (waveform_class == WaveformClass::NoSilence)
+        {
+            std::vector<std::tuple<uint64_t, uint64_t>> v {{ 0, frames }};
+            return v;
+        }
+        if (waveform_class == WaveformClass::AllSilent)
+        {
+            return slice_silent(waveform, samples_count, channels);
+        }
+    }
+
+    std::vector<double> rms_list = get_envelope(waveform, frames, channels, levels);
+    return slice_envelope(rms_list, frames, levels);
+}
 
-    if (samples.size() <= this->min_length)
+std::vector<std::tuple<uint64_t, uint64_t>>
+Slicer::slice(const int16_t *waveform, uint64_t samples_count, unsigned int channels)
+{
+    // classify() only reads float samples, so 16-bit input always gets the full analysis, with the same result.
+    uint64_t frames = samples_count / channels;
+    if (frames <= this->min_length)
     {
         std::vector<std::tuple<uint64_t, uint64_t>> v {{ 0, frames }};
         return v;
     }
+    RmsHistogram histogram(this->auto_window);
+    RmsHistogram *levels = this->auto_threshold ? &histogram : nullptr;
+    std::vector<double> rms_list = get_envelope(waveform, frames, channels, levels);
+    return slice_envelope(rms_list, frames, levels);
+}
+
+std::vector<std::tuple<uint64_t, uint64_t>>
+Slicer::slice(const float *waveform, uint64_t samples_count, unsigned int channels, std::vector<ChunkStats>& stats)
+{
+    /*
+     * Same as slice(), but also measures each chunk. Peaks and clipping are collected per hop,
+     * and chunks only sum up the hops they cover.
+     */
+    uint64_t frames = samples_count / channels;
+    uint64_t hops = frames / this->hop_size + 1;
+    std::vector<float> hop_peaks(hops);
+    std::vector<uint64_t> hop_clipped(hops);
+
+    for (uint64_t i = 0; i < frames; i++)
+    {
+        uint64_t hop = i / this->hop_size;
+        for (unsigned int j = 0; j < channels; j++)
+        {
+            float a = std::fabs(waveform[i * channels + j]);
+            hop_peaks[hop] = std::max(hop_peaks[hop], a);
+            hop_clipped[hop] += (a >= CLIP_LEVEL);
+        }
+    }
+
+    RmsHistogram histogram(this->auto_window);
+    RmsHistogram *levels = this->auto_threshold ? &histogram : nullptr;
+    std::vector<double> rms_list = get_envelope(waveform, frames, channels, levels);
+    auto chunks = slice_envelope(rms_list, frames, levels);
+    stats = envelope_stats(rms_list, chunks);
+    for (auto& chunk_stats : stats)
+    {
+        uint64_t first = chunk_stats.begin / this->hop_size;
+        uint64_t last = std::min(hops, (chunk_stats.end + this->hop_size - 1) / this->hop_size);
+        for (uint64_t hop = first; hop < last; hop++)
+        {
+            chunk_stats.peak = std::max(chunk_stats.peak, hop_peaks[hop]);
+            chunk_stats.clipped += hop_clipped[hop];
+        }
+    }
+    return chunks;
+}
+
+std::vector<ChunkStats>
+Slicer::envelope_stats(const std::vector<double>& rms_list, const std::vector<std::tuple<uint64_t, uint64_t>>& chunks) const
+{
+    // The silence floor is the mean level of all silent hops, or the quietest hop if none is silent.
+    double floor_sum = 0;
+    uint64_t floor_count = 0;
+    for (uint64_t i = 0; i < rms_list.size(); i++)
+    {
+        if (rms_list[i] < this->threshold_at(i))
+        {
+            floor_sum += rms_list[i];
+            floor_count++;
+        }
+    }
+    double noise_floor = (floor_count > 0) ? (floor_sum / (double)floor_count) :
+            (rms_list.empty() ? 0.0 : *std::min_element(rms_list.begin(), rms_list.end()));
+    noise_floor = std::max(noise_floor, 1e-10);
+
+    std::vector<ChunkStats> stats;
+    for (auto chunk : chunks)
+    {
+        ChunkStats chunk_stats {};
+        chunk_stats.begin = std::get<0>(chunk);
+        chunk_stats.end = std::get<1>(chunk);
+        uint64_t length = (chunk_stats.end > chunk_stats.begin) ? (chunk_stats.end - chunk_stats.begin) : 0;
+        uint64_t first = std::min((uint64_t)rms_list.size(), chunk_stats.begin / this->hop_size);
+        uint64_t last = std::min((uint64_t)rms_list.size(), (chunk_stats.end + this->hop_size - 1) / this->hop_size);
 
-    std::vector<double> rms_list = get_rms<float>(samples, (uint64_t) this->win_size, (uint64_t) this->hop_size);
+        double sum = 0;
+        for (uint64_t i = first; i < last; i++)
+        {
+            sum += rms_list[i];
+            chunk_stats.max_rms = std::max(chunk_stats.max_rms, rms_list[i]);
+        }
+        chunk_stats.mean_rms = (last > first) ? (sum / (double)(last - first)) : 0.0;
+        chunk_stats.snr_db = 20.0 * std::log10(std::max(chunk_stats.mean_rms, 1e-10) / noise_floor);
+
+        uint64_t i = first;
+        while ((i < last) && (rms_list[i] < this->threshold_at(i)))
+        {
+            i++;
+        }
+        chunk_stats.leading_silence = std::min(length, (i - first) * this->hop_size);
+        uint64_t j = last;
+        while ((j > i) && (rms_list[j - 1] < this->threshold_at(j - 1)))
+        {
+            j--;
+        }
+        chunk_stats.trailing_silence = std::min(length - chunk_stats.leading_silence, (last - j) * this->hop_size);
+        stats.push_back(chunk_stats);
+    }
+    return stats;
+}
+
+void Slicer::sample_stats(const float *waveform, uint64_t samples, ChunkStats& stats)
+{
+    // Accumulates peak and clipping over interleaved samples, which may come in several blocks.
+    for (uint64_t i = 0; i < samples; i++)
+    {
+        float a = std::fabs(waveform[i]);
+        stats.peak = std::max(stats.peak, a);
+        stats.clipped += (a >= CLIP_LEVEL);
+    }
+}
+
+WaveformClass Slicer::classify(const float *waveform, uint64_t samples, unsigned int channels) const
+{
+    /*
+     * The RMS of hop k covers the frames [k * hop + padding - win, k * hop + padding) of the
+     * zero-padded input. Its energy is at least that of the blocks lying inside the window and
+     * at most that of the blocks touching it; one frame of slack on each side absorbs the exact
+     * window alignment, and a small relative margin the rounding of the envelope's running sum.
+     */
+    const double MARGIN = 1e-3;
+    uint64_t frames = samples / channels;
+    uint64_t hops = frames / this->hop_size + 1;
+    uint64_t block = std::max<uint64_t>(1, this->hop_size / 4);
+    uint64_t padding = this->win_size / 2;
+    double limit = this->threshold * this->threshold * (double)this->win_size;
+    double silent_limit = limit * (1.0 - MARGIN);
+    double loud_limit = limit * (1.0 + MARGIN);
+
+    std::vector<double> energy;
+    energy.reserve(frames / block + 1);
+    bool may_be_silent = true;
+    bool may_be_loud = true;
+    uint64_t hop = 0;
+
+    auto check_hop = [&](uint64_t k)
+    {
+        uint64_t end = k * this->hop_size + padding;
+        uint64_t outer_begin = (end >= this->win_size + 1) ? end - this->win_size - 1 : 0;
+        uint64_t outer_end = std::min(frames, end + 1);
+        uint64_t inner_begin = (end >= this->win_size - 1) ? end - this->win_size + 1 : 0;
+        uint64_t inner_end = std::min(frames, (end >= 1) ? end - 1 : 0);
+
+        if (may_be_silent)
+        {
+            double upper = 0;
+            for (uint64_t b = outer_begin / block; b * block < outer_end; b++)
+            {
+                upper += energy[b];
+            }
+            may_be_silent = (upper < silent_limit);
+        }
+        if (may_be_loud)
+        {
+            double lower = 0;
+            for (uint64_t b = (inner_begin + block - 1) / block; b < energy.size() && std::min(frames, (b + 1) * block) <= inner_end; b++)
+            {
+                lower += energy[b];
+            }
+            may_be_loud = (lower >= loud_limit);
+        }
+    };
+
+    for (uint64_t begin = 0; begin < frames; begin += block)
+    {
+        uint64_t end = std::min(frames, begin + block);
+        double sum = 0;
+        for (uint64_t i = begin; i < end; i++)
+        {
+            float s = 0;
+            for (unsigned int j = 0; j < channels; j++)
+            {
+                s += waveform[i * channels + j] / (float)channels;
+            }
+            sum += (double)s * s;
+        }
+        energy.push_back(sum);
+
+        // Check every hop whose window is now complete.
+        while ((hop < hops) && (hop * this->hop_size + padding + 1 <= end))
+        {
+            check_hop(hop++);
+            if (!may_be_silent && !may_be_loud)
+            {
+                return WaveformClass::Mixed;
+            }
+        }
+    }
+    while (hop < hops)
+    {
+        check_hop(hop++);
+        if (!may_be_silent && !may_be_loud)
+        {
+            return WaveformClass::Mixed;
+        }
+    }
+
+    if (may_be_silent)
+    {
+        return WaveformClass::AllSilent;
+    }
+    return may_be_loud ? WaveformClass::NoSilence : WaveformClass::Mixed;
+}
+
+std::vector<std::tuple<uint64_t, uint64_t>>
+Slicer::slice_silent(const float *waveform, uint64_t samples, unsigned int channels)
+{
+    /*
+     * What slice_envelope() returns when every hop is silent: only the trailing silence rule
+     * applies, which cuts at the quietest of the first max_sil_kept + 1 hops. Their RMS is
+     * computed from a prefix long enough for the envelope to have the same values bit for bit.
+     */
+    uint64_t frames = samples / channels;
+    uint64_t hops = frames / this->hop_size + 1;
+    if (hops < this->min_interval)
+    {
+        std::vector<std::tuple<uint64_t, uint64_t>> v {{ 0, frames }};
+        return v;
+    }
+    uint64_t last = std::min(hops - 1, this->max_sil_kept);
+    uint64_t prefix = std::min(frames, last * this->hop_size + this->win_size + 1);
+    std::vector<double> rms_list = get_envelope(waveform, prefix, channels, nullptr);
+    uint64_t pos = argmin_range_view<double>(rms_list, 0, last + 1);
+
+    std::vector<std::tuple<uint64_t, uint64_t>> chunks;
+    if (pos > 0)
+    {
+        chunks.emplace_back(0, std::min(frames, pos * this->hop_size));
+    }
+    return chunks;
+}
+
+std::vector<std::tuple<uint64_t, uint64_t>>
+Slicer::slice_envelope(const std::vector<double>& rms_list, uint64_t frames, const RmsHistogram *histogram)
+{
+    if (this->auto_threshold)
+    {
+        estimate_thresholds(rms_list, histogram);
+    }
+
+    if (frames <= this->min_length)
+    {
+        std::vector<std::tuple<uint64_t, uint64_t>> v {{ 0, frames }};
+        return v;
+    }
 
     std::vector<std::tuple<uint64_t, uint64_t>> sil_tags;
     uint64_t silence_start = 0;
@@ -64,7 +462,7 @@ Slicer::slice(const std::vector<float>& waveform, unsigned int channels)
     {
         double rms = rms_list[i];
         // Keep looping while frame is silent.
-        if (rms < this->threshold)
+        if (rms < this->threshold_at(i))
         {
             // Record start of silent frames.
             if (!has_silence_start)
@@ -149,6 +547,7 @@ Slicer::slice(const std::vector<float>& waveform, unsigned int channels)
     if (sil_tags.empty())
     {
         std::vector<std::tuple<uint64_t, uint64_t>> v {{ 0, frames }};
+        split_long_chunks(rms_list, frames, v);
         return v;
     }
     else
@@ -174,92 +573,757 @@ Slicer::slice(const std::vector<float>& waveform, unsigned int channels)
             end = total_frames;
             chunks.emplace_back(begin * this->hop_size, std::min(frames, end * this->hop_size));
         }
+        split_long_chunks(rms_list, frames, chunks);
         return chunks;
     }
 }
 
-template<class T>
-inline std::vector<double> get_rms(const std::vector<T>& arr, uint64_t frame_length, uint64_t hop_length)
+void Slicer::split_long_chunks(const std::vector<double>& rms_list, uint64_t frames, std::vector<std::tuple<uint64_t, uint64_t>>& chunks) const
+{
+    if (this->max_length == 0)
+    {
+        return;
+    }
+    uint64_t max_frames = this->max_length * this->hop_size;
+    bool too_long = false;
+    for (const auto& chunk : chunks)
+    {
+        too_long = too_long || (std::get<1>(chunk) - std::get<0>(chunk) > max_frames);
+    }
+    if (!too_long)
+    {
+        return;
+    }
+
+    /*
+     * A chunk of length R hops needs n = ceil(R / max) pieces. Each cut leaves a first piece
+     * of at least R - (n - 1) * max hops, so that the rest still fits in n - 1 pieces, and at
+     * least max / 2 hops on both sides; within those bounds it goes at the quietest hop.
+     */
+    RangeMinimum quietest(rms_list);
+    uint64_t half = this->max_length / 2;
+    std::vector<std::tuple<uint64_t, uint64_t>> result;
+    for (const auto& chunk : chunks)
+    {
+        uint64_t begin = std::get<0>(chunk);
+        uint64_t end = std::get<1>(chunk);
+        uint64_t cur = begin / this->hop_size;
+        uint64_t last = (end + this->hop_size - 1) / this->hop_size;
+        while (last - cur > this->max_length)
+        {
+            uint64_t remaining = last - cur;
+            uint64_t pieces = (remaining + this->max_length - 1) / this->max_length;
+            uint64_t low = cur + std::max(remaining - (pieces - 1) * this->max_length, half);
+            uint64_t high = cur + std::min(this->max_length, remaining - half);
+            uint64_t cut = quietest.query(std::min(low, (uint64_t)rms_list.size() - 1),
+                                          std::min(high + 1, (uint64_t)rms_list.size()));
+            result.emplace_back(begin, cut * this->hop_size);
+            begin = cut * this->hop_size;
+            cur = cut;
+        }
+        result.emplace_back(begin, std::min(frames, end));
+    }
+    chunks = std::move(result);
+}
+
+uint64_t Slicer::get_hop_size() const
+{
+    return this->hop_size;
+}
+
+uint64_t Slicer::get_win_size() const
+{
+    return this->win_size;
+}
+
+void Slicer::set_max_length(uint64_t max_length_ms)
+{
+    if (max_length_ms == 0)
+    {
+        this->max_length = 0;
+        return;
+    }
+    // Checked with the rounding of min_length, but rounded down so that no clip exceeds the requested length.
+    if (divIntRound<uint64_t>(max_length_ms * (uint64_t)this->sample_rate, (uint64_t)1000 * this->hop_size) < this->min_length)
+    {
+        throw std::invalid_argument("The following condition must be satisfied: max_length >= min_length");
+    }
+    this->max_length = std::max<uint64_t>(2, max_length_ms * (uint64_t)this->sample_rate / ((uint64_t)1000 * this->hop_size));
+}
+
+void Slicer::set_channel_mode(ChannelMode mode)
+{
+    this->channel_mode = mode;
+}
+
+void Slicer::set_single_precision(bool single_precision)
+{
+    this->single_precision = single_precision;
+}
+
+template<class Sample>
+std::vector<double> Slicer::get_envelope(const Sample *waveform, uint64_t frames, unsigned int channels, RmsHistogram *histogram) const
+{
+    ChannelMode mode = (channels > 1) ? this->channel_mode : ChannelMode::Mix;
+    if (this->single_precision)
+    {
+        return envelope_of<Sample, float>(waveform, frames, channels, mode, this->win_size, this->hop_size, histogram);
+    }
+    return envelope_of<Sample, double>(waveform, frames, channels, mode, this->win_size, this->hop_size, histogram);
+}
+
+void Slicer::set_auto_threshold(double percentile, double offset_db, uint64_t window_ms)
+{
+    if (!((percentile >= 0) && (percentile <= 100)))
+    {
+        throw std::invalid_argument("The noise percentile must be between 0 and 100");
+    }
+    this->auto_threshold = true;
+    this->auto_percentile = percentile;
+    this->auto_offset_db = offset_db;
+    this->auto_window = divIntRound<uint64_t>(window_ms * (uint64_t)this->sample_rate, (uint64_t)1000 * this->hop_size);
+    this->window_thresholds.clear();
+}
+
+bool Slicer::has_auto_threshold() const
+{
+    return this->auto_threshold;
+}
+
+std::vector<double> Slicer::get_thresholds_db() const
+{
+    std::vector<double> thresholds_db;
+    if (this->window_thresholds.empty())
+    {
+        thresholds_db.push_back(20.0 * std::log10(this->threshold));
+    }
+    for (double threshold : this->window_thresholds)
+    {
+        thresholds_db.push_back(20.0 * std::log10(threshold));
+    }
+    return thresholds_db;
+}
+
+double Slicer::threshold_at(uint64_t hop) const
+{
+    if (this->window_thresholds.empty())
+    {
+        return this->threshold;
+    }
+    uint64_t window = (this->auto_window > 0) ? hop / this->auto_window : 0;
+    return this->window_thresholds[std::min(window, (uint64_t)this->window_thresholds.size() - 1)];
+}
+
+void Slicer::estimate_thresholds(const std::vector<double>& rms_list, const RmsHistogram *histogram)
+{
+    // The envelope of a two-pass run arrives without a histogram; counting its hops is cheap.
+    RmsHistogram own(this->auto_window);
+    if (!histogram)
+    {
+        for (double rms : rms_list)
+        {
+            own.add(rms);
+        }
+        histogram = &own;
+    }
+
+    this->window_thresholds.clear();
+    for (uint64_t window = 0; window < histogram->windows(); window++)
+    {
+        double threshold_db = histogram->percentile_db(window, this->auto_percentile) + this->auto_offset_db;
+        this->window_thresholds.push_back(std::pow(10, threshold_db / 20.0));
+    }
+}
+
+RmsHistogram::RmsHistogram(uint64_t window_hops)
+        : window_hops(window_hops),
+          hops(0)
+{}
+
+void RmsHistogram::add(double rms)
+{
+    uint64_t window = (this->window_hops > 0) ? this->hops / this->window_hops : 0;
+    if (this->counts.size() < (window + 1) * BINS)
+    {
+        this->counts.resize((window + 1) * BINS);
+    }
+    int bin = 0;
+    if (rms > 0)
+    {
+        double level = (20.0 * std::log10(rms) - MIN_DB) / BIN_DB;
+        bin = (int)std::min(std::max(level, 0.0), (double)(BINS - 1));
+    }
+    this->counts[window * BINS + bin]++;
+    this->hops++;
+}
+
+uint64_t RmsHistogram::windows() const
+{
+    return this->counts.size() / BINS;
+}
+
+double RmsHistogram::percentile_db(uint64_t window, double percentile) const
+{
+    uint64_t first = window;
+    if ((window > 0) && (this->window_hops > 0) && (window + 1 == this->windows()) &&
+        (this->hops - window * this->window_hops < this->window_hops / 2))
+    {
+        first = window - 1;
+    }
+
+    uint64_t bins[BINS] = {};
+    uint64_t total = 0;
+    for (uint64_t w = first; w <= window; w++)
+    {
+        for (int i = 0; i < BINS; i++)
+        {
+            bins[i] += this->counts[w * BINS + i];
+            total += this->counts[w * BINS + i];
+        }
+    }
+    if (total == 0)
+    {
+        return MIN_DB;
+    }
+
+    auto target = (uint64_t)std::ceil(percentile / 100.0 * (double)total);
+    target = std::max(target, (uint64_t)1);
+    uint64_t cumulative = 0;
+    for (int i = 0; i < BINS; i++)
+    {
+        cumulative += bins[i];
+        if (cumulative >= target)
+        {
+            return MIN_DB + (i + 0.5) * BIN_DB;
+        }
+    }
+    return 0.0;
+}
+
+RmsEnvelope::RmsEnvelope(uint64_t frame_length, uint64_t hop_length)
+        : frame_length(frame_length),
+          hop_length(hop_length),
+          padding(frame_length / 2),
+          window(frame_length),
+          pos(0),
+          hop_count(0),
+          val(0),
+          count(0)
 {
-    uint64_t arr_length = arr.size();
+    if (this->padding == 0)
+    {
+        this->rms.push_back(0.0);
+    }
+}
+
+void RmsEnvelope::feed(const float *waveform, uint64_t frames, unsigned int channels)
+{
+    double value;
+    for (uint64_t i = 0; i < frames; i++)
+    {
+        if (step(true, downmix(waveform + i * channels, channels), value))
+        {
+            this->rms.push_back(value);
+        }
+    }
+}
+
+float RmsEnvelope::downmix(const float *frame, unsigned int channels)
+{
+    // Same downmix as BasicSlicer, so the envelope matches Slicer::slice bit for bit.
+    float s = 0;
+    for (unsigned int j = 0; j < channels; j++)
+    {
+        s += frame[j] / (float)channels;
+    }
+    return s;
+}
+
+uint64_t RmsEnvelope::frames() const
+{
+    return this->pos;
+}
+
+std::vector<double> RmsEnvelope::take()
+{
+    std::vector<double> v;
+    v.swap(this->rms);
+    return v;
+}
+
+std::vector<double> RmsEnvelope::finish()
+{
+    // Drain the right padding, exactly like the last loop of BasicSlicer::envelope.
+    uint64_t rms_size = this->pos / this->hop_length + 1;
+    double value;
+    while (this->count < rms_size)
+    {
+        if (step(false, 0, value))
+        {
+            this->rms.push_back(value);
+        }
+    }
+    return take();
+}
 
-    uint64_t padding = frame_length / 2;
+void RmsEnvelope::save_state(std::ostream& os) const
+{
+    write_state(os, this->frame_length);
+    write_state(os, this->hop_length);
+    write_state(os, this->pos);
+    write_state(os, this->hop_count);
+    write_state(os, this->val);
+    write_state(os, this->count);
+    write_state_vector(os, this->window);
+    write_state_vector(os, this->rms);
+}
 
-    uint64_t rms_size = arr_length / hop_length + 1;
+void RmsEnvelope::load_state(std::istream& is)
+{
+    uint64_t saved_frame_length, saved_hop_length;
+    read_state(is, saved_frame_length);
+    read_state(is, saved_hop_length);
+    if ((saved_frame_length != this->frame_length) || (saved_hop_length != this->hop_length))
+    {
+        throw std::invalid_argument("Saved state was created with different slicer parameters");
+    }
+    read_state(is, this->pos);
+    read_state(is, this->hop_count);
+    read_state(is, this->val);
+    read_state(is, this->count);
+    read_state_vector(is, this->window);
+    read_state_vector(is, this->rms);
+    if (this->window.size() != this->frame_length)
+    {
+        throw std::runtime_error("Saved state is corrupted");
+    }
+}
 
-    std::vector<double> rms = std::vector<double>(rms_size);
+bool RmsEnvelope::step(bool has_sample, float sample, double& value)
+{
+    /*
+     * Handles one position of the sliding window. A sample enters the window on the right,
+     * and the sample frame_length positions earlier (if any) leaves it on the left.
+     * The order of floating point operations follows BasicSlicer::envelope with double sums. Returns whether this completed
+     * an RMS value, which is then stored in value.
+     */
+    uint64_t slot = this->pos % this->frame_length;
+    bool has_removed = (this->pos >= this->frame_length);
+    float removed = has_removed ? this->window[slot] : 0;
 
-    uint64_t left = 0;
-    uint64_t right = 0;
-    uint64_t hop_count = 0;
+    if (has_sample && has_removed)
+    {
+        this->val += (double)sample * sample - (double)removed * removed;
+    }
+    else if (has_sample)
+    {
+        this->val += (double)sample * sample;
+    }
+    else if (has_removed)
+    {
+        this->val -= (double)removed * removed;
+    }
+    if (has_sample)
+    {
+        this->window[slot] = sample;
+    }
+    this->pos++;
 
-    uint64_t rms_index = 0;
-    double val = 0;
+    if (this->pos < this->padding)
+    {
+        return false;
+    }
+    if ((this->pos == this->padding) || (++this->hop_count == this->hop_length))
+    {
+        value = std::sqrt(std::max(0.0, (double)this->val / (double)this->frame_length));
+        this->count++;
+        this->hop_count = 0;
+        return true;
+    }
+    return false;
+}
 
-    // Initial condition: the frame is at the beginning of padded array
-    while ((right < padding) && (right < arr_length))
+StreamSlicer::StreamSlicer(const Slicer& slicer)
+        : threshold(slicer.threshold),
+          hop_size(slicer.hop_size),
+          min_length(slicer.min_length),
+          min_interval(slicer.min_interval),
+          max_sil_kept(slicer.max_sil_kept),
+          envelope(slicer.win_size, slicer.hop_size),
+          index(0),
+          chunk_count(0),
+          has_silence_start(false),
+          silence_start(0),
+          clip_start(0),
+          has_tags(false),
+          in_gap(false),
+          tail(slicer.max_sil_kept + 1)
+{
+    if (slicer.auto_threshold)
     {
-        val += (double)arr[right] * arr[right];
-        right++;
+        throw std::invalid_argument("The automatic threshold needs the whole input and cannot be used when streaming");
     }
-    rms[rms_index++] = (std::sqrt(std::max(0.0, (double)val / (double)frame_length)));
+    if (slicer.channel_mode != ChannelMode::Mix)
+    {
+        throw std::invalid_argument("Per-channel analysis is not supported when streaming");
+    }
+    if (slicer.max_length > 0)
+    {
+        throw std::invalid_argument("The maximum clip length needs the whole input and cannot be used when streaming");
+    }
+    this->head.reserve(this->max_sil_kept + 1);
+}
 
-    // Left side or right side of the frame has not touched the sides of original array
-    while ((right < frame_length) && (right < arr_length) && (rms_index < rms_size))
+std::vector<std::tuple<uint64_t, uint64_t>>
+StreamSlicer::feed(const float *waveform, uint64_t frames, unsigned int channels)
+{
+    std::vector<std::tuple<uint64_t, uint64_t>> chunks;
+    feed_into(waveform, frames, channels, chunks);
+    return chunks;
+}
+
+std::vector<std::tuple<uint64_t, uint64_t>> StreamSlicer::finish()
+{
+    std::vector<std::tuple<uint64_t, uint64_t>> chunks;
+    finish_into(chunks);
+    return chunks;
+}
+
+void StreamSlicer::feed_into(const float *waveform, uint64_t frames, unsigned int channels,
+                             std::vector<std::tuple<uint64_t, uint64_t>>& chunks)
+{
+    /*
+     * Each RMS value is processed as soon as the envelope completes it, so nothing is allocated
+     * here beyond the chunks appended, at most one per value plus the one left by the envelope's
+     * constructor.
+     */
+    flush_envelope(chunks);
+    double rms;
+    for (uint64_t i = 0; i < frames; i++)
     {
-        val += (double)arr[right] * arr[right];
-        hop_count++;
-        if (hop_count == hop_length)
+        if (this->envelope.step(true, RmsEnvelope::downmix(waveform + i * channels, channels), rms))
         {
-            rms[rms_index++] = (std::sqrt(std::max(0.0, (double)val / (double)frame_length)));
-            hop_count = 0;
+            process(rms, chunks);
         }
-        right++;  // Move right 1 step at a time.
     }
+}
+
+void StreamSlicer::flush_envelope(std::vector<std::tuple<uint64_t, uint64_t>>& chunks)
+{
+    // Values the envelope holds without them having been processed, such as the first one when it has no padding.
+    for (double rms : this->envelope.rms)
+    {
+        process(rms, chunks);
+    }
+    this->envelope.rms.clear();
+}
 
-    if (frame_length < arr_length)
+void StreamSlicer::finish_into(std::vector<std::tuple<uint64_t, uint64_t>>& chunks)
+{
+    size_t first_chunk = chunks.size();
+    uint64_t frames = this->envelope.frames();
+    if ((this->chunk_count == 0) && (frames <= this->min_length))
+    {
+        chunks.emplace_back(0, frames);
+        this->chunk_count++;
+        return;
+    }
+    // Drain the right padding of the envelope, like RmsEnvelope::finish.
+    flush_envelope(chunks);
+    uint64_t rms_size = frames / this->envelope.hop_length + 1;
+    double rms;
+    while (this->envelope.count < rms_size)
     {
-        while ((right < arr_length) && (rms_index < rms_size))
+        if (this->envelope.step(false, 0, rms))
         {
-            val += (double)arr[right] * arr[right] - (double)arr[left] * arr[left];
-            hop_count++;
-            if (hop_count == hop_length)
-            {
-                rms[rms_index++] = (std::sqrt(std::max(0.0, (double)val / (double)frame_length)));
-                hop_count = 0;
-            }
-            left++;
-            right++;
+            process(rms, chunks);
         }
     }
+
+    // Deal with trailing silence.
+    uint64_t total_frames = this->index;
+    if (this->has_silence_start && !this->in_gap && ((total_frames - this->silence_start) >= this->min_interval))
+    {
+        uint64_t silence_end = std::min(total_frames - 1, this->silence_start + this->max_sil_kept);
+        emit_chunk(argmin_head(this->silence_start, silence_end + 1), chunks);
+    }
+    else if (!(this->has_silence_start && this->in_gap) && (!this->has_tags || (this->clip_start < total_frames)))
+    {
+        chunks.emplace_back(this->clip_start * this->hop_size, frames);
+        this->chunk_count++;
+    }
+    // Clamp the last chunk to the stream length, like Slicer::slice_envelope does.
+    if (chunks.size() > first_chunk)
+    {
+        std::get<1>(chunks.back()) = std::min(frames, std::get<1>(chunks.back()));
+    }
+}
+
+uint64_t StreamSlicer::frames() const
+{
+    return this->envelope.frames();
+}
+
+uint64_t StreamSlicer::chunks() const
+{
+    return this->chunk_count;
+}
+
+uint64_t StreamSlicer::committed() const
+{
+    /*
+     * Every frame before this position has been decided: it either belongs to a chunk that has
+     * already been returned, to the open chunk, or to no chunk at all.
+     */
+    uint64_t frames = this->envelope.frames();
+    if (frames <= this->min_length)
+    {
+        return 0;
+    }
+    uint64_t hop;
+    if (this->in_gap)
+    {
+        // The next clip starts at least max_sil_kept hops before the next non-silent hop.
+        hop = (this->index > this->max_sil_kept) ? (this->index - this->max_sil_kept) : 0;
+    }
+    else if (this->has_silence_start)
+    {
+        hop = this->silence_start;
+    }
     else
     {
-        while ((right < frame_length) && (rms_index < rms_size))
+        hop = this->index;
+    }
+    return std::min(frames, hop * this->hop_size);
+}
+
+bool StreamSlicer::has_open_chunk() const
+{
+    return !this->in_gap;
+}
+
+uint64_t StreamSlicer::open_chunk_begin() const
+{
+    return this->clip_start * this->hop_size;
+}
+
+void StreamSlicer::save_state(std::ostream& os) const
+{
+    os.write(STATE_MAGIC, sizeof(STATE_MAGIC));
+    write_state(os, this->threshold);
+    write_state(os, this->min_length);
+    write_state(os, this->min_interval);
+    write_state(os, this->max_sil_kept);
+    this->envelope.save_state(os);
+    write_state(os, this->index);
+    write_state(os, this->chunk_count);
+    write_state(os, this->has_silence_start);
+    write_state(os, this->silence_start);
+    write_state(os, this->clip_start);
+    write_state(os, this->has_tags);
+    write_state(os, this->in_gap);
+    write_state_vector(os, this->head);
+    write_state_vector(os, this->tail);
+}
+
+void StreamSlicer::load_state(std::istream& is)
+{
+    char magic[sizeof(STATE_MAGIC)];
+    if (!is.read(magic, sizeof(magic)) || (std::memcmp(magic, STATE_MAGIC, sizeof(magic)) != 0))
+    {
+        throw std::runtime_error("Not a slicer state file");
+    }
+    double saved_threshold;
+    uint64_t saved_min_length, saved_min_interval, saved_max_sil_kept;
+    read_state(is, saved_threshold);
+    read_state(is, saved_min_length);
+    read_state(is, saved_min_interval);
+    read_state(is, saved_max_sil_kept);
+    if ((saved_threshold != this->threshold) || (saved_min_length != this->min_length) ||
+        (saved_min_interval != this->min_interval) || (saved_max_sil_kept != this->max_sil_kept))
+    {
+        throw std::invalid_argument("Saved state was created with different slicer parameters");
+    }
+    this->envelope.load_state(is);
+    read_state(is, this->index);
+    read_state(is, this->chunk_count);
+    read_state(is, this->has_silence_start);
+    read_state(is, this->silence_start);
+    read_state(is, this->clip_start);
+    read_state(is, this->has_tags);
+    read_state(is, this->in_gap);
+    read_state_vector(is, this->head);
+    read_state_vector(is, this->tail);
+    if ((this->head.size() > this->max_sil_kept + 1) || (this->tail.size() != this->max_sil_kept + 1))
+    {
+        throw std::runtime_error("Saved state is corrupted");
+    }
+}
+
+void StreamSlicer::process(double rms, std::vector<std::tuple<uint64_t, uint64_t>>& chunks)
+{
+    /*
+     * One iteration of the main loop of Slicer::slice_envelope. Only the RMS values that loop can
+     * still look at are kept: the first max_sil_kept + 1 values of the current silence, and
+     * the last max_sil_kept + 1 values.
+     */
+    uint64_t i = this->index++;
+    this->tail[i % this->tail.size()] = rms;
+    if (this->has_silence_start && (this->head.size() <= this->max_sil_kept))
+    {
+        this->head.push_back(rms);
+    }
+
+    uint64_t pos = 0, pos_l = 0, pos_r = 0;
+
+    // Keep looping while frame is silent.
+    if (rms < this->threshold)
+    {
+        // Record start of silent frames.
+        if (!this->has_silence_start)
+        {
+            this->silence_start = i;
+            this->has_silence_start = true;
+            this->head.clear();
+            this->head.push_back(rms);
+        }
+        else if (!this->in_gap &&
+                 ((i - this->silence_start) > (this->max_sil_kept * 2)) &&
+                 ((i - this->silence_start) >= this->min_interval) &&
+                 ((i - this->clip_start) >= this->min_length))
         {
-            hop_count++;
-            if (hop_count == hop_length)
+            // A slice here is certain, and so is the end of the current clip.
+            if (this->silence_start == 0)
+            {
+                emit_chunk(0, chunks);
+            }
+            else
             {
-                rms[rms_index++] = (std::sqrt(std::max(0.0, (double)val / (double)frame_length)));
-                hop_count = 0;
+                emit_chunk(argmin_head(this->silence_start, this->silence_start + this->max_sil_kept + 1), chunks);
             }
-            right++;
+            this->in_gap = true;
         }
+        return;
+    }
+    // Keep looping while frame is not silent and silence start has not been recorded.
+    if (!this->has_silence_start)
+    {
+        return;
+    }
+    // Clear recorded silence start if interval is not enough or clip is too short
+    bool is_leading_silence = ((this->silence_start == 0) && (i > this->max_sil_kept));
+    bool need_slice_middle = (
+            ( (i - this->silence_start) >= this->min_interval) &&
+            ( (i - this->clip_start) >= this->min_length) );
+    if ((!is_leading_silence) && (!need_slice_middle))
+    {
+        this->has_silence_start = false;
+        return;
     }
 
-    while ((left < arr_length) && (rms_index < rms_size)/* && (right < arr_length + padding)*/)
+    // Need slicing. Record the range of silent frames to be removed.
+    uint64_t begin, end;
+    if ((i - this->silence_start) <= this->max_sil_kept)
     {
-        val -= (double)arr[left] * arr[left];
-        hop_count++;
-        if (hop_count == hop_length)
+        pos = argmin_head(this->silence_start, i + 1);
+        begin = (this->silence_start == 0) ? 0 : pos;
+        end = pos;
+    }
+    else if ((i - this->silence_start) <= (this->max_sil_kept * 2))
+    {
+        pos = argmin_head(i - this->max_sil_kept, this->silence_start + this->max_sil_kept + 1);
+        pos_l = argmin_head(this->silence_start, this->silence_start + this->max_sil_kept + 1);
+        pos_r = argmin_tail(i - this->max_sil_kept, i + 1);
+        if (this->silence_start == 0)
         {
-            rms[rms_index++] = (std::sqrt(std::max(0.0, (double)val / (double)frame_length)));
-            hop_count = 0;
+            begin = 0;
+            end = pos_r;
         }
-        left++;
-        right++;
+        else
+        {
+            begin = std::min(pos_l, pos);
+            end = std::max(pos_r, pos);
+        }
+    }
+    else
+    {
+        pos_l = argmin_head(this->silence_start, this->silence_start + this->max_sil_kept + 1);
+        pos_r = argmin_tail(i - this->max_sil_kept, i + 1);
+        begin = (this->silence_start == 0) ? 0 : pos_l;
+        end = pos_r;
+    }
+    // In a gap, the chunk ending at this silence has already been returned.
+    if (!this->in_gap)
+    {
+        emit_chunk(begin, chunks);
     }
+    this->clip_start = end;
+    this->in_gap = false;
+    this->has_silence_start = false;
+}
+
+void StreamSlicer::emit_chunk(uint64_t end, std::vector<std::tuple<uint64_t, uint64_t>>& chunks)
+{
+    // The first silence tag produces no chunk when it starts at the very beginning.
+    if (this->has_tags || (end > 0))
+    {
+        chunks.emplace_back(this->clip_start * this->hop_size, end * this->hop_size);
+        this->chunk_count++;
+    }
+    this->has_tags = true;
+}
+
+uint64_t StreamSlicer::argmin_head(uint64_t begin, uint64_t end) const
+{
+    // Absolute index of the first minimum within [begin, end), looked up in the head buffer.
+    auto first = this->head.begin() + (begin - this->silence_start);
+    auto last = this->head.begin() + std::min(end - this->silence_start, (uint64_t)this->head.size());
+    return begin + std::distance(first, std::min_element(first, last));
+}
 
-    return rms;
+uint64_t StreamSlicer::argmin_tail(uint64_t begin, uint64_t end) const
+{
+    // Absolute index of the first minimum within [begin, end), looked up in the tail ring buffer.
+    uint64_t size = this->tail.size();
+    uint64_t pos = begin;
+    for (uint64_t j = begin + 1; j < end; j++)
+    {
+        if (this->tail[j % size] < this->tail[pos % size])
+        {
+            pos = j;
+        }
+    }
+    return pos;
+}
+
+template<class Sample, class Accumulator>
+inline std::vector<double> envelope_of(const Sample *waveform, uint64_t frames, unsigned int channels, ChannelMode mode,
+                                       uint64_t frame_length, uint64_t hop_length, RmsHistogram *histogram)
+{
+    /*
+     * Mono and stereo get kernels of their own, other channel counts the generic one. A single
+     * channel is always mixed, since every rule gives it the same envelope.
+     */
+    if (channels == 1)
+    {
+        return BasicSlicer<Sample, 1, Accumulator, MixRule>::envelope(waveform, frames, channels, frame_length, hop_length, histogram);
+    }
+    switch (mode)
+    {
+        case ChannelMode::Max:
+            return (channels == 2) ?
+                    BasicSlicer<Sample, 2, Accumulator, MaxRule>::envelope(waveform, frames, channels, frame_length, hop_length, histogram) :
+                    BasicSlicer<Sample, ANY_CHANNELS, Accumulator, MaxRule>::envelope(waveform, frames, channels, frame_length, hop_length, histogram);
+        case ChannelMode::Power:
+            return (channels == 2) ?
+                    BasicSlicer<Sample, 2, Accumulator, PowerRule>::envelope(waveform, frames, channels, frame_length, hop_length, histogram) :
+                    BasicSlicer<Sample, ANY_CHANNELS, Accumulator, PowerRule>::envelope(waveform, frames, channels, frame_length, hop_length, histogram);
+        case ChannelMode::Mix:
+            break;
+    }
+    return (channels == 2) ?
+            BasicSlicer<Sample, 2, Accumulator, MixRule>::envelope(waveform, frames, channels, frame_length, hop_length, histogram) :
+            BasicSlicer<Sample, ANY_CHANNELS, Accumulator, MixRule>::envelope(waveform, frames, channels, frame_length, hop_length, histogram);
 }
 
 template<class T>
@@ -288,20 +1352,41 @@ inline uint64_t argmin_range_view(const std::vector<T>& v, uint64_t begin, uint6
 }
 
 template<class T>
-inline std::vector<T> multichannel_to_mono(const std::vector<T>& v, unsigned int channels)
+inline void write_state(std::ostream& os, const T& value)
 {
-    uint64_t frames = v.size() / channels;
-    std::vector<T> out(frames);
+    // States are only meant to be read back on the same machine, so native byte order is fine.
+    os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
 
-    for (uint64_t i = 0; i < frames; i++)
+template<class T>
+inline void read_state(std::istream& is, T& value)
+{
+    if (!is.read(reinterpret_cast<char *>(&value), sizeof(T)))
     {
-        T s = 0;
-        for (unsigned int j = 0; j < channels; j++)
-        {
-            s += (T)v[i * channels + j] / (T)channels;
-        }
-        out[i] = s;
+        throw std::runtime_error("Saved state is truncated");
     }
+}
+
+template<class T>
+inline void write_state_vector(std::ostream& os, const std::vector<T>& v)
+{
+    write_state(os, (uint64_t)v.size());
+    os.write(reinterpret_cast<const char *>(v.data()), (std::streamsize)(v.size() * sizeof(T)));
+}
 
-    return out;
-}
\ No newline at end of file
+template<class T>
+inline void read_state_vector(std::istream& is, std::vector<T>& v)
+{
+    uint64_t size;
+    read_state(is, size);
+    // Guard against absurd sizes from a corrupted file before allocating.
+    if (size > (uint64_t)(1 << 28))
+    {
+        throw std::runtime_error("Saved state is corrupted");
+    }
+    v.resize(size);
+    if (!is.read(reinterpret_cast<char *>(v.data()), (std::streamsize)(size * sizeof(T))))
+    {
+        throw std::runtime_error("Saved state is truncated");
+    }
+}
@@ -7,6 +7,71 @@
 
 #include <vector>
 #include <tuple>
+#include <cstdint>
+#include <iosfwd>
+
+/*
+ * Statistics of one sliced chunk. Positions and lengths are in frames, levels are linear
+ * amplitudes (1.0 is full scale).
+ */
+struct ChunkStats {
+    uint64_t begin;
+    uint64_t end;
+    // Largest absolute sample value over all channels.
+    float peak;
+    // Number of samples at or above CLIP_LEVEL.
+    uint64_t clipped;
+    double mean_rms;
+    double max_rms;
+    // Mean RMS of the chunk against the mean RMS of all silent hops of the input.
+    double snr_db;
+    uint64_t leading_silence;
+    uint64_t trailing_silence;
+};
+
+/*
+ * Histogram of RMS levels in fixed bins of BIN_DB decibels from MIN_DB to full scale, so that
+ * percentiles are found without sorting. Values are added in hop order and counted separately
+ * for every window of window_hops hops (a single window if 0), which lets a percentile follow
+ * a noise floor that drifts over a long recording.
+ */
+class RmsHistogram {
+public:
+    static constexpr double MIN_DB = -120.0;
+    static constexpr double BIN_DB = 0.25;
+    static constexpr int BINS = 480;
+
+private:
+    uint64_t window_hops;
+    uint64_t hops;
+    std::vector<uint32_t> counts;
+
+public:
+    explicit RmsHistogram(uint64_t window_hops = 0);
+    void add(double rms);
+    uint64_t windows() const;
+    // Level in dB below which the given percentage of the window's hops lie. A window shorter
+    // than half the window length is merged with the one before it.
+    double percentile_db(uint64_t window, double percentile) const;
+};
+
+/*
+ * How the channels of a multichannel waveform are combined into one RMS envelope. Mix downmixes
+ * to mono first, so out-of-phase content cancels out. Max takes the loudest channel, which
+ * keeps a hop if any channel is active; Power takes the RMS over all samples of all channels.
+ */
+enum class ChannelMode {
+    Mix,
+    Max,
+    Power
+};
+
+// What a cheap scan of a waveform could prove about its hops, see Slicer::classify.
+enum class WaveformClass {
+    Mixed,
+    AllSilent,
+    NoSilence
+};
 
 class Slicer {
 private:
@@ -16,10 +81,170 @@ private:
     uint64_t min_length;
     uint64_t min_interval;
     uint64_t max_sil_kept;
+    // Longest clip in hops, 0 for no limit.
+    uint64_t max_length;
+    ChannelMode channel_mode;
+    int sample_rate;
+
+    // Automatic threshold: a percentile of the RMS levels plus an offset, per window of hops.
+    bool auto_threshold;
+    double auto_percentile;
+    double auto_offset_db;
+    uint64_t auto_window;
+    std::vector<double> window_thresholds;
+    // Window sums in float rather than double, see BasicSlicer.
+    bool single_precision;
+
+    double threshold_at(uint64_t hop) const;
+    // Picks the BasicSlicer kernel for the sample type, channel count, channel mode and precision.
+    template<class Sample>
+    std::vector<double> get_envelope(const Sample *waveform, uint64_t frames, unsigned int channels, RmsHistogram *histogram) const;
+    std::vector<std::tuple<uint64_t, uint64_t>> slice_silent(const float *waveform, uint64_t samples, unsigned int channels);
+    void split_long_chunks(const std::vector<double>& rms_list, uint64_t frames, std::vector<std::tuple<uint64_t, uint64_t>>& chunks) const;
+    void estimate_thresholds(const std::vector<double>& rms_list, const RmsHistogram *histogram);
+
+    friend class StreamSlicer;
 
 public:
     Slicer(int sr, double threshold = -40.0, uint64_t min_length = 5000, uint64_t min_interval = 300, uint64_t hop_size = 20, uint64_t max_sil_kept = 5000);
     std::vector<std::tuple<uint64_t, uint64_t>> slice(const std::vector<float>& waveform, unsigned int channels);
+    std::vector<std::tuple<uint64_t, uint64_t>> slice(const std::vector<float>& waveform, unsigned int channels, std::vector<ChunkStats>& stats);
+    std::vector<std::tuple<uint64_t, uint64_t>> slice(const float *waveform, uint64_t samples, unsigned int channels);
+    std::vector<std::tuple<uint64_t, uint64_t>> slice(const float *waveform, uint64_t samples, unsigned int channels, std::vector<ChunkStats>& stats);
+    // 16-bit samples of full scale 32768, with the same result as their float conversion.
+    std::vector<std::tuple<uint64_t, uint64_t>> slice(const int16_t *waveform, uint64_t samples, unsigned int channels);
+    std::vector<std::tuple<uint64_t, uint64_t>> slice_envelope(const std::vector<double>& rms_list, uint64_t frames, const RmsHistogram *histogram = nullptr);
+    std::vector<ChunkStats> envelope_stats(const std::vector<double>& rms_list, const std::vector<std::tuple<uint64_t, uint64_t>>& chunks) const;
+    static void sample_stats(const float *waveform, uint64_t samples, ChunkStats& stats);
+    /*
+     * Bounds the RMS of every hop by the energy of small blocks fully inside or overlapping its
+     * window, without downmixing into a separate buffer. Returns AllSilent or NoSilence only
+     * when the bounds prove it, and stops as soon as both are ruled out. slice() uses this to
+     * skip the full analysis for such waveforms.
+     */
+    WaveformClass classify(const float *waveform, uint64_t samples, unsigned int channels) const;
+    uint64_t get_hop_size() const;
+    uint64_t get_win_size() const;
+    /*
+     * Replaces the fixed threshold by one estimated from each input: the level below which
+     * percentile % of the hops lie, which is the noise floor when the input has enough
+     * silence, raised by offset_db. With window_ms > 0 it is estimated separately for every
+     * window of that length. Not supported by StreamSlicer.
+     */
+    void set_auto_threshold(double percentile, double offset_db, uint64_t window_ms = 0);
+    /*
+     * Splits every clip longer than max_length_ms into the fewest pieces that fit, each at
+     * least half of max_length_ms long, cutting at the quietest hop allowed for each cut.
+     * 0 removes the limit. Not supported by StreamSlicer.
+     */
+    void set_max_length(uint64_t max_length_ms);
+    // Not supported by StreamSlicer, which always downmixes.
+    void set_channel_mode(ChannelMode mode);
+    /*
+     * Sums the RMS windows in float rather than double. Every window is summed afresh, so the
+     * envelope does not drift, but its values differ from the double ones by a few parts per
+     * million; a level that close to the threshold can change a decision, and with it a
+     * boundary by more than a hop. Not used by StreamSlicer.
+     */
+    void set_single_precision(bool single_precision);
+    bool has_auto_threshold() const;
+    // Thresholds in dB used by the last slice, one per window.
+    std::vector<double> get_thresholds_db() const;
+};
+
+/*
+ * Computes the same RMS envelope as Slicer::slice, but from audio fed in blocks,
+ * so the whole waveform never needs to be held in memory.
+ */
+class RmsEnvelope {
+private:
+    uint64_t frame_length;
+    uint64_t hop_length;
+    uint64_t padding;
+    std::vector<float> window;
+    uint64_t pos;
+    uint64_t hop_count;
+    double val;
+    uint64_t count;
+    std::vector<double> rms;
+
+    bool step(bool has_sample, float sample, double& value);
+    static float downmix(const float *frame, unsigned int channels);
+
+    friend class StreamSlicer;
+
+public:
+    RmsEnvelope(uint64_t frame_length, uint64_t hop_length);
+    void feed(const float *waveform, uint64_t frames, unsigned int channels);
+    uint64_t frames() const;
+    std::vector<double> take();
+    std::vector<double> finish();
+    void save_state(std::ostream& os) const;
+    void load_state(std::istream& is);
+};
+
+/*
+ * Incremental version of Slicer::slice. Audio is fed in blocks of any size, and each chunk is
+ * returned as soon as its boundaries can no longer change. Memory use depends only on the
+ * slicer parameters, not on the length of the stream.
+ *
+ * A chunk is returned once the silence following it has lasted for
+ * max(min_interval, 2 * max_sil_kept + 1) hops and the chunk has reached min_length, plus half
+ * an RMS window of lookahead. This is the worst-case latency between the end of a clip and
+ * its chunk being returned by feed().
+ *
+ * The chunks are identical to those of Slicer::slice, except that a stream which is silent
+ * from the very beginning until it ends produces no chunk at all.
+ *
+ * The whole state can be saved with save_state() and restored with load_state(), so a stream
+ * that keeps growing can be sliced in several runs without feeding any frame twice.
+ */
+class StreamSlicer {
+private:
+    double threshold;
+    uint64_t hop_size;
+    uint64_t min_length;
+    uint64_t min_interval;
+    uint64_t max_sil_kept;
+
+    RmsEnvelope envelope;
+    uint64_t index;
+    uint64_t chunk_count;
+
+    bool has_silence_start;
+    uint64_t silence_start;
+    uint64_t clip_start;
+    bool has_tags;
+    // The end of the current clip is already known, but the start of the next one is not.
+    bool in_gap;
+
+    // RMS values from silence_start up to silence_start + max_sil_kept.
+    std::vector<double> head;
+    // RMS values of the last max_sil_kept + 1 hops, indexed modulo its size.
+    std::vector<double> tail;
+
+    // Append to chunks and allocate nothing else; they never allocate once chunks has room.
+    void feed_into(const float *waveform, uint64_t frames, unsigned int channels, std::vector<std::tuple<uint64_t, uint64_t>>& chunks);
+    void finish_into(std::vector<std::tuple<uint64_t, uint64_t>>& chunks);
+    void flush_envelope(std::vector<std::tuple<uint64_t, uint64_t>>& chunks);
+    void process(double rms, std::vector<std::tuple<uint64_t, uint64_t>>& chunks);
+    void emit_chunk(uint64_t end, std::vector<std::tuple<uint64_t, uint64_t>>& chunks);
+    uint64_t argmin_head(uint64_t begin, uint64_t end) const;
+    uint64_t argmin_tail(uint64_t begin, uint64_t end) const;
+
+    friend class RealtimeSlicer;
+
+public:
+    explicit StreamSlicer(const Slicer& slicer);
+    std::vector<std::tuple<uint64_t, uint64_t>> feed(const float *waveform, uint64_t frames, unsigned int channels);
+    std::vector<std::tuple<uint64_t, uint64_t>> finish();
+    uint64_t frames() const;
+    uint64_t chunks() const;
+    uint64_t committed() const;
+    bool has_open_chunk() const;
+    uint64_t open_chunk_begin() const;
+    void save_state(std::ostream& os) const;
+    void load_state(std::istream& is);
 };
 
 #endif //AUDIO_SLICER_SLICER_H
\ No newline at end of file
@@ -0,0 +1,341 @@
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+
+#include "transform.h"
+
+// Filter settings per quality level: half length in taps at the input rate, passband edge
+// relative to the Nyquist frequency, and Kaiser window beta.
+struct ResampleQuality {
+    uint64_t half_taps;
+    double rolloff;
+    double beta;
+};
+
+static const ResampleQuality RESAMPLE_QUALITY[] = {
+        {8, 0.85, 5.0},
+        {16, 0.90, 6.5},
+        {32, 0.945, 8.0},
+        {64, 0.97, 9.5},
+};
+
+static const double PI = 3.14159265358979323846;
+
+// Above this many phases, the fractional position is rounded to the nearest of this many.
+static const uint64_t MAX_PHASES = 1024;
+
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12)
+        {
+            break;
+        }
+    }
+    return sum;
+}
+
+static double sinc(double x)
+{
+    if (std::fabs(x) < 1e-12)
+    {
+        return 1.0;
+    }
+    return std::sin(PI * x) / (PI * x);
+}
+
+/*
+ * Second-order IIR section, direct form I, used for the K-weighting filter of ITU-R BS.1770.
+ */
+struct Biquad {
+    double b0, b1, b2, a1, a2;
+    double x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+
+    double process(double x)
+    {
+        double y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        return y;
+    }
+};
+
+static void k_weighting(int sr, Biquad& shelf, Biquad& highpass)
+{
+    // Coefficients derived for any sample rate, matching the 48 kHz values given by BS.1770.
+    double f0 = 1681.974450955533;
+    double gain_db = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = std::tan(PI * f0 / sr);
+    double vh = std::pow(10.0, gain_db / 20.0);
+    double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    shelf = {(vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0,
+             2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0};
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = std::tan(PI * f0 / sr);
+    a0 = 1.0 + k / q + k * k;
+    highpass = {1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0};
+}
+
+bool ClipTransform::enabled() const
+{
+    return (this->gain_mode != GainMode::None) || (this->target_sr > 0);
+}
+
+double default_target_db(GainMode mode)
+{
+    switch (mode)
+    {
+        case GainMode::Rms:
+            return -20.0;
+        case GainMode::Lufs:
+            return -23.0;
+        default:
+            return -1.0;
+    }
+}
+
+ClipProcessor::ClipProcessor(const ClipTransform& transform, int sr, unsigned int channels)
+        : transform(transform),
+          sr(sr),
+          channels(channels),
+          up(1),
+          down(1),
+          phases(1),
+          taps(0),
+          half(0)
+{
+    if ((transform.target_sr <= 0) || (transform.target_sr == sr))
+    {
+        return;
+    }
+    if ((transform.quality < 0) || (transform.quality > 3))
+    {
+        throw std::invalid_argument("Resample quality must be between 0 and 3");
+    }
+
+    uint64_t g = std::gcd((uint64_t)sr, (uint64_t)transform.target_sr);
+    this->up = (uint64_t)transform.target_sr / g;
+    this->down = (uint64_t)sr / g;
+    this->phases = std::min(this->up, MAX_PHASES);
+
+    /*
+     * Windowed sinc, widened by down / up when downsampling so that the cutoff follows the
+     * lower Nyquist frequency. Each phase holds the taps for one fractional input position,
+     * normalized to unity gain at DC.
+     */
+    const ResampleQuality& q = RESAMPLE_QUALITY[transform.quality];
+    double scale = std::min(1.0, (double)this->up / (double)this->down);
+    double cutoff = scale * q.rolloff;
+    double width = (double)q.half_taps / scale;
+    // Keep the number of taps a multiple of four for the unrolled dot product.
+    this->half = ((uint64_t)std::ceil(width) + 1) / 2 * 2;
+    this->taps = 2 * this->half;
+    this->filter.resize(this->phases * this->taps);
+    double i0_beta = bessel_i0(q.beta);
+    for (uint64_t p = 0; p < this->phases; p++)
+    {
+        double frac = (double)p / (double)this->phases;
+        float *h = this->filter.data() + p * this->taps;
+        double sum = 0;
+        for (uint64_t j = 0; j < this->taps; j++)
+        {
+            double u = frac + (double)this->half - 1.0 - (double)j;
+            double r = u / width;
+            double w = (std::fabs(r) < 1.0) ? (bessel_i0(q.beta * std::sqrt(1.0 - r * r)) / i0_beta) : 0.0;
+            double v = cutoff * sinc(cutoff * u) * w;
+            h[j] = (float)v;
+            sum += v;
+        }
+        for (uint64_t j = 0; j < this->taps; j++)
+        {
+            h[j] = (float)(h[j] / sum);
+        }
+    }
+}
+
+int ClipProcessor::output_rate() const
+{
+    return (this->taps > 0) ? this->transform.target_sr : this->sr;
+}
+
+const std::vector<float>& ClipProcessor::process(const float *clip, uint64_t frames)
+{
+    /*
+     * The gain is applied last, to the output: the resampling filter overshoots on sharp edges,
+     * so only the peak of the resampled clip tells how far it can be raised.
+     */
+    if (this->taps > 0)
+    {
+        resample(clip, frames);
+    }
+    else
+    {
+        this->output.assign(clip, clip + frames * this->channels);
+    }
+    if (this->transform.gain_mode == GainMode::None)
+    {
+        return this->output;
+    }
+
+    float peak = 0;
+    for (float v : this->output)
+    {
+        peak = std::max(peak, std::fabs(v));
+    }
+    // Loudness hardly changes with the rate, so it is measured on the input, where the filters are set up.
+    double level = (this->transform.gain_mode == GainMode::Peak) ? 20.0 * std::log10(peak) : measure_db(clip, frames);
+    // Never push the peak over full scale, which integer formats would wrap around.
+    double gain_db = std::isfinite(level) ? (this->transform.target_db - level) : 0.0;
+    gain_db = std::min(gain_db, (peak > 0) ? -20.0 * std::log10(peak) : 0.0);
+    auto gain = (float)std::pow(10.0, gain_db / 20.0);
+    // The gain is rounded, which could still leave the loudest sample a hair over 1.
+    while (peak * gain > 1.0f)
+    {
+        gain = std::nextafter(gain, 0.0f);
+    }
+    for (float& v : this->output)
+    {
+        v *= gain;
+    }
+    return this->output;
+}
+
+double ClipProcessor::measure_db(const float *clip, uint64_t frames) const
+{
+    uint64_t samples = frames * this->channels;
+    if (samples == 0)
+    {
+        return -INFINITY;
+    }
+    if (this->transform.gain_mode == GainMode::Peak)
+    {
+        float peak = 0;
+        for (uint64_t i = 0; i < samples; i++)
+        {
+            peak = std::max(peak, std::fabs(clip[i]));
+        }
+        return 20.0 * std::log10(peak);
+    }
+    if (this->transform.gain_mode == GainMode::Rms)
+    {
+        double sum = 0;
+        for (uint64_t i = 0; i < samples; i++)
+        {
+            sum += (double)clip[i] * clip[i];
+        }
+        return 10.0 * std::log10(sum / (double)samples);
+    }
+
+    /*
+     * Integrated loudness as in ITU-R BS.1770: K-weighted energy summed over channels, in 400 ms
+     * blocks with 75% overlap, gated at -70 LUFS and then 10 LU below the mean of the remaining
+     * blocks. All channels are weighted equally. Clips shorter than one block are one block.
+     */
+    uint64_t step = std::max<uint64_t>(1, (uint64_t)this->sr / 10);
+    uint64_t segments = std::max<uint64_t>(1, frames / step);
+    std::vector<double> energy(segments);
+    for (unsigned int c = 0; c < this->channels; c++)
+    {
+        Biquad shelf {}, highpass {};
+        k_weighting(this->sr, shelf, highpass);
+        for (uint64_t i = 0; i < frames; i++)
+        {
+            double y = highpass.process(shelf.process(clip[i * this->channels + c]));
+            if (i / step < segments)
+            {
+                energy[i / step] += y * y;
+            }
+        }
+    }
+
+    std::vector<double> blocks;
+    uint64_t block_segments = std::min<uint64_t>(4, segments);
+    uint64_t block_frames = std::min(frames, block_segments * step);
+    for (uint64_t i = 0; i + block_segments <= segments; i++)
+    {
+        double e = 0;
+        for (uint64_t j = 0; j < block_segments; j++)
+        {
+            e += energy[i + j];
+        }
+        e /= (double)block_frames;
+        if (-0.691 + 10.0 * std::log10(e) > -70.0)
+        {
+            blocks.push_back(e);
+        }
+    }
+    if (blocks.empty())
+    {
+        return -INFINITY;
+    }
+    double relative_gate = std::accumulate(blocks.begin(), blocks.end(), 0.0) / (double)blocks.size() * std::pow(10.0, -1.0);
+    double sum = 0;
+    uint64_t count = 0;
+    for (double e : blocks)
+    {
+        if (e > relative_gate)
+        {
+            sum += e;
+            count++;
+        }
+    }
+    return (count > 0) ? (-0.691 + 10.0 * std::log10(sum / (double)count)) : -INFINITY;
+}
+
+void ClipProcessor::resample(const float *clip, uint64_t frames)
+{
+    /*
+     * Each channel is copied once into a zero padded contiguous buffer, so that every output
+     * sample is a plain dot product between one filter phase and consecutive input samples.
+     */
+    uint64_t out_frames = (frames * this->up + this->down - 1) / this->down;
+    // One more frame of zeros for a position rounded up to the next input frame.
+    uint64_t stride = frames + 2 * this->half + 1;
+    this->padded.assign(stride * this->channels, 0.0f);
+    for (uint64_t i = 0; i < frames; i++)
+    {
+        for (unsigned int c = 0; c < this->channels; c++)
+        {
+            this->padded[c * stride + this->half + i] = clip[i * this->channels + c];
+        }
+    }
+
+    this->output.resize(out_frames * this->channels);
+    for (uint64_t n = 0; n < out_frames; n++)
+    {
+        uint64_t position = n * this->down;
+        uint64_t base = position / this->up;
+        uint64_t phase = ((position % this->up) * this->phases + this->up / 2) / this->up;
+        if (phase == this->phases)
+        {
+            base++;
+            phase = 0;
+        }
+        const float *h = this->filter.data() + phase * this->taps;
+        for (unsigned int c = 0; c < this->channels; c++)
+        {
+            const float *x = this->padded.data() + c * stride + base + 1;
+            // Four independent sums let the compiler keep several multiply-adds in flight.
+            float acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+            for (uint64_t j = 0; j < this->taps; j += 4)
+            {
+                acc0 += h[j] * x[j];
+                acc1 += h[j + 1] * x[j + 1];
+                acc2 += h[j + 2] * x[j + 2];
+                acc3 += h[j + 3] * x[j + 3];
+            }
+            this->output[n * this->channels + c] = (acc0 + acc1) + (acc2 + acc3);
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef AUDIO_SLICER_TRANSFORM_H
+#define AUDIO_SLICER_TRANSFORM_H
+
+#include <cstdint>
+#include <vector>
+
+enum class GainMode {
+    None,
+    Peak,
+    Rms,
+    Lufs
+};
+
+/*
+ * Optional processing applied to every clip while it is written.
+ */
+struct ClipTransform {
+    GainMode gain_mode = GainMode::None;
+    // dBFS for Peak and Rms, LUFS for Lufs.
+    double target_db = -1.0;
+    // Sample rate of the written clips, 0 keeps the rate of the input.
+    int target_sr = 0;
+    // Resampling quality from 0 (fastest) to 3 (best).
+    int quality = 2;
+
+    bool enabled() const;
+};
+
+double default_target_db(GainMode mode);
+
+/*
+ * Applies a ClipTransform to clips of one input. The resampling filter and all buffers are kept
+ * between clips, so each worker should own one ClipProcessor and reuse it.
+ */
+class ClipProcessor {
+private:
+    ClipTransform transform;
+    int sr;
+    unsigned int channels;
+
+    // Polyphase resampling filter: output rate / input rate = up / down.
+    uint64_t up;
+    uint64_t down;
+    uint64_t phases;
+    uint64_t taps;
+    uint64_t half;
+    std::vector<float> filter;
+
+    std::vector<float> padded;
+    std::vector<float> output;
+
+    double measure_db(const float *clip, uint64_t frames) const;
+    void resample(const float *clip, uint64_t frames);
+
+public:
+    ClipProcessor(const ClipTransform& transform, int sr, unsigned int channels);
+    int output_rate() const;
+    // Returns the transformed interleaved frames; valid until the next call.
+    const std::vector<float>& process(const float *clip, uint64_t frames);
+};
+
+#endif //AUDIO_SLICER_TRANSFORM_H
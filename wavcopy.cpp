@@ -0,0 +1,367 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#endif
+
+#include "wavcopy.h"
+
+static constexpr uint16_t WAVE_FORMAT_PCM = 1;
+static constexpr uint16_t WAVE_FORMAT_IEEE_FLOAT = 3;
+static constexpr uint64_t RIFF_MAX_SIZE = 0xFFFFFFFFull;
+// Block size the clip is lined up to, so that file systems with shared extents can reflink it.
+static constexpr uint64_t EXTENT_ALIGNMENT = 4096;
+// Smaller clips are not worth up to a block of padding in their header.
+static constexpr uint64_t ALIGN_MIN_BYTES = 16 * EXTENT_ALIGNMENT;
+static constexpr uint64_t COPY_BUFFER_BYTES = (uint64_t)1 << 20;
+
+
+static uint16_t get_u16(const unsigned char *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_u16(std::vector<unsigned char>& v, uint16_t x)
+{
+    v.push_back((unsigned char)(x & 0xFF));
+    v.push_back((unsigned char)(x >> 8));
+}
+
+static void put_u32(std::vector<unsigned char>& v, uint32_t x)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        v.push_back((unsigned char)((x >> (8 * i)) & 0xFF));
+    }
+}
+
+static void put_tag(std::vector<unsigned char>& v, const char *tag)
+{
+    v.insert(v.end(), tag, tag + 4);
+}
+
+bool read_wav_layout(const std::filesystem::path& path, WavLayout& layout)
+{
+    std::ifstream is(path, std::ios::binary);
+    unsigned char riff[12];
+    if (!is.read(reinterpret_cast<char *>(riff), sizeof(riff)) ||
+        (std::memcmp(riff, "RIFF", 4) != 0) || (std::memcmp(riff + 8, "WAVE", 4) != 0))
+    {
+        return false;
+    }
+    is.seekg(0, std::ios::end);
+    auto file_size = (uint64_t)is.tellg();
+
+    bool have_fmt = false;
+    bool have_data = false;
+    uint64_t pos = sizeof(riff);
+    while (!have_data && (pos + 8 <= file_size))
+    {
+        unsigned char header[8];
+        is.seekg((std::streamoff)pos);
+        if (!is.read(reinterpret_cast<char *>(header), sizeof(header)))
+        {
+            return false;
+        }
+        uint64_t size = get_u32(header + 4);
+        if (std::memcmp(header, "fmt ", 4) == 0)
+        {
+            unsigned char fmt[16];
+            if ((size < sizeof(fmt)) || !is.read(reinterpret_cast<char *>(fmt), sizeof(fmt)))
+            {
+                return false;
+            }
+            layout.format_tag = get_u16(fmt);
+            layout.channels = get_u16(fmt + 2);
+            layout.sample_rate = get_u32(fmt + 4);
+            layout.block_align = get_u16(fmt + 12);
+            layout.bits_per_sample = get_u16(fmt + 14);
+            have_fmt = true;
+        }
+        else if (std::memcmp(header, "data", 4) == 0)
+        {
+            // Recorders that were interrupted leave a data size larger than the file.
+            layout.data_offset = pos + 8;
+            layout.data_size = std::min(size, file_size - layout.data_offset);
+            have_data = true;
+        }
+        pos += 8 + size + (size & 1);
+    }
+    if (!have_fmt || !have_data || (layout.channels == 0))
+    {
+        return false;
+    }
+
+    bool pcm = (layout.format_tag == WAVE_FORMAT_PCM) &&
+            ((layout.bits_per_sample == 8) || (layout.bits_per_sample == 16) ||
+             (layout.bits_per_sample == 24) || (layout.bits_per_sample == 32));
+    bool ieee_float = (layout.format_tag == WAVE_FORMAT_IEEE_FLOAT) &&
+            ((layout.bits_per_sample == 32) || (layout.bits_per_sample == 64));
+    return (pcm || ieee_float) && (layout.block_align == layout.channels * (layout.bits_per_sample / 8));
+}
+
+#ifdef __linux__
+
+class FileDescriptor {
+public:
+    int fd;
+
+    explicit FileDescriptor(int fd) : fd(fd) {}
+    ~FileDescriptor()
+    {
+        if (this->fd >= 0)
+        {
+            close(this->fd);
+        }
+    }
+};
+
+static void write_all(int fd, const unsigned char *data, uint64_t size, uint64_t offset)
+{
+    while (size > 0)
+    {
+        ssize_t n = pwrite(fd, data, size, (off_t)offset);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            throw std::runtime_error(std::string("Cannot write clip: ") + std::strerror(errno));
+        }
+        data += n;
+        size -= (uint64_t)n;
+        offset += (uint64_t)n;
+    }
+}
+
+static bool unsupported(int err)
+{
+    // Reasons a kernel copy is not possible here, as opposed to an I/O error.
+    return (err == ENOSYS) || (err == EXDEV) || (err == EINVAL) || (err == EOPNOTSUPP) || (err == ENOTTY);
+}
+
+static bool clone_range(int in, int out, uint64_t in_offset, uint64_t out_offset, uint64_t size)
+{
+#ifdef FICLONERANGE
+    struct file_clone_range range {};
+    range.src_fd = in;
+    range.src_offset = in_offset;
+    range.src_length = size;
+    range.dest_offset = out_offset;
+    return ioctl(out, FICLONERANGE, &range) == 0;
+#else
+    return false;
+#endif
+}
+
+static void copy_range(int in, int out, uint64_t in_offset, uint64_t out_offset, uint64_t size)
+{
+    while (size > 0)
+    {
+        auto in_pos = (loff_t)in_offset;
+        auto out_pos = (loff_t)out_offset;
+        ssize_t n = copy_file_range(in, &in_pos, out, &out_pos, size, 0);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n < 0 && unsupported(errno))
+        {
+            break;
+        }
+        if (n <= 0)
+        {
+            throw std::runtime_error(std::string("Cannot copy clip: ") + (n == 0 ? "unexpected end of file" : std::strerror(errno)));
+        }
+        in_offset += (uint64_t)n;
+        out_offset += (uint64_t)n;
+        size -= (uint64_t)n;
+    }
+
+    // Older kernels cannot copy_file_range across file systems; sendfile writes at the file position.
+    if (size > 0 && lseek(out, (off_t)out_offset, SEEK_SET) >= 0)
+    {
+        while (size > 0)
+        {
+            auto in_pos = (off_t)in_offset;
+            ssize_t n = sendfile(out, in, &in_pos, std::min(size, COPY_BUFFER_BYTES));
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n < 0 && unsupported(errno))
+            {
+                break;
+            }
+            if (n <= 0)
+            {
+                throw std::runtime_error(std::string("Cannot copy clip: ") + (n == 0 ? "unexpected end of file" : std::strerror(errno)));
+            }
+            in_offset += (uint64_t)n;
+            out_offset += (uint64_t)n;
+            size -= (uint64_t)n;
+        }
+    }
+
+    std::vector<unsigned char> buffer(size > 0 ? std::min(size, COPY_BUFFER_BYTES) : 0);
+    while (size > 0)
+    {
+        ssize_t n = pread(in, buffer.data(), std::min(size, (uint64_t)buffer.size()), (off_t)in_offset);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            throw std::runtime_error(std::string("Cannot read clip: ") + (n == 0 ? "unexpected end of file" : std::strerror(errno)));
+        }
+        write_all(out, buffer.data(), (uint64_t)n, out_offset);
+        in_offset += (uint64_t)n;
+        out_offset += (uint64_t)n;
+        size -= (uint64_t)n;
+    }
+}
+
+#endif
+
+bool copy_wav_clip(const std::filesystem::path& src, const WavLayout& layout, uint64_t begin, uint64_t end,
+                   const std::filesystem::path& dst)
+{
+    uint64_t src_offset = layout.data_offset + begin * layout.block_align;
+    uint64_t data_size = (end - begin) * layout.block_align;
+    bool ieee_float = (layout.format_tag == WAVE_FORMAT_IEEE_FLOAT);
+
+    // Float files carry an empty fmt extension and a fact chunk, as the WAV specification asks.
+    uint32_t fmt_size = ieee_float ? 18 : 16;
+    uint64_t header_size = 12 + 8 + fmt_size + (ieee_float ? 12 : 0) + 8;
+    uint64_t padding = 0;
+    bool aligned = false;
+    if (data_size >= ALIGN_MIN_BYTES)
+    {
+        // A JUNK chunk moves the samples to the same offset within a block as in the source.
+        padding = (src_offset % EXTENT_ALIGNMENT + EXTENT_ALIGNMENT - (header_size + 8) % EXTENT_ALIGNMENT) % EXTENT_ALIGNMENT;
+        aligned = (padding % 2 == 0);
+        if (aligned)
+        {
+            header_size += 8 + padding;
+        }
+    }
+    if (header_size - 8 + data_size + (data_size & 1) > RIFF_MAX_SIZE)
+    {
+        return false;
+    }
+
+    std::vector<unsigned char> header;
+    header.reserve(header_size);
+    put_tag(header, "RIFF");
+    put_u32(header, (uint32_t)(header_size - 8 + data_size + (data_size & 1)));
+    put_tag(header, "WAVE");
+    put_tag(header, "fmt ");
+    put_u32(header, fmt_size);
+    put_u16(header, layout.format_tag);
+    put_u16(header, layout.channels);
+    put_u32(header, layout.sample_rate);
+    put_u32(header, layout.sample_rate * layout.block_align);
+    put_u16(header, layout.block_align);
+    put_u16(header, layout.bits_per_sample);
+    if (ieee_float)
+    {
+        put_u16(header, 0);
+        put_tag(header, "fact");
+        put_u32(header, 4);
+        put_u32(header, (uint32_t)(end - begin));
+    }
+    if (aligned)
+    {
+        put_tag(header, "JUNK");
+        put_u32(header, (uint32_t)padding);
+        header.resize(header.size() + padding, 0);
+    }
+    put_tag(header, "data");
+    put_u32(header, (uint32_t)data_size);
+
+#ifdef __linux__
+    FileDescriptor in(open(src.c_str(), O_RDONLY | O_CLOEXEC));
+    if (in.fd < 0)
+    {
+        throw std::runtime_error("Cannot open " + src.string() + ": " + std::strerror(errno));
+    }
+    FileDescriptor out(open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666));
+    if (out.fd < 0)
+    {
+        throw std::runtime_error("Cannot create " + dst.string() + ": " + std::strerror(errno));
+    }
+    write_all(out.fd, header.data(), header.size(), 0);
+
+    uint64_t out_offset = header_size;
+    uint64_t remaining = data_size;
+    if (aligned)
+    {
+        // Up to the first block boundary, then whole blocks shared if the file system allows.
+        uint64_t head = std::min(remaining, (EXTENT_ALIGNMENT - src_offset % EXTENT_ALIGNMENT) % EXTENT_ALIGNMENT);
+        copy_range(in.fd, out.fd, src_offset, out_offset, head);
+        src_offset += head;
+        out_offset += head;
+        remaining -= head;
+        uint64_t blocks = remaining / EXTENT_ALIGNMENT * EXTENT_ALIGNMENT;
+        if (blocks > 0 && clone_range(in.fd, out.fd, src_offset, out_offset, blocks))
+        {
+            src_offset += blocks;
+            out_offset += blocks;
+            remaining -= blocks;
+        }
+    }
+    copy_range(in.fd, out.fd, src_offset, out_offset, remaining);
+    if (data_size & 1)
+    {
+        unsigned char pad = 0;
+        write_all(out.fd, &pad, 1, out_offset + remaining);
+    }
+#else
+    std::ifstream is(src, std::ios::binary);
+    std::ofstream os(dst, std::ios::binary | std::ios::trunc);
+    if (!is || !os)
+    {
+        throw std::runtime_error("Cannot copy " + src.string() + " to " + dst.string());
+    }
+    os.write(reinterpret_cast<const char *>(header.data()), (std::streamsize)header.size());
+    is.seekg((std::streamoff)src_offset);
+    std::vector<char> buffer(std::min(std::max(data_size, (uint64_t)1), COPY_BUFFER_BYTES));
+    uint64_t remaining = data_size;
+    while (remaining > 0)
+    {
+        auto n = (std::streamsize)std::min(remaining, (uint64_t)buffer.size());
+        if (!is.read(buffer.data(), n))
+        {
+            throw std::runtime_error("Cannot read clip from " + src.string());
+        }
+        os.write(buffer.data(), n);
+        remaining -= (uint64_t)n;
+    }
+    if (data_size & 1)
+    {
+        os.put(0);
+    }
+    if (!os.flush())
+    {
+        throw std::runtime_error("Cannot write " + dst.string());
+    }
+#endif
+    return true;
+}
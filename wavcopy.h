@@ -0,0 +1,36 @@
+#ifndef AUDIO_SLICER_WAVCOPY_H
+#define AUDIO_SLICER_WAVCOPY_H
+
+#include <cstdint>
+#include <filesystem>
+
+// Where the samples of an uncompressed WAV file are, and how they are encoded.
+struct WavLayout {
+    uint16_t format_tag;
+    uint16_t channels;
+    uint32_t sample_rate;
+    uint16_t block_align;
+    uint16_t bits_per_sample;
+    uint64_t data_offset;
+    uint64_t data_size;
+};
+
+/*
+ * Reads the layout of a plain PCM or IEEE float WAV file. Returns false for anything else,
+ * including WAVE_FORMAT_EXTENSIBLE, compressed formats and RF64.
+ */
+bool read_wav_layout(const std::filesystem::path& path, WavLayout& layout);
+
+/*
+ * Writes frames [begin, end) of a WAV file to dst without decoding them: a new header is
+ * written and the bytes of the clip are copied by the kernel where possible (reflink, then
+ * copy_file_range, then sendfile on Linux), or by plain reads and writes elsewhere. On file
+ * systems with shared extents the header is padded so the clip lines up with the blocks of
+ * the source and can share them. Returns false, writing nothing, if the clip is too large for
+ * a RIFF header. Throws std::runtime_error on I/O errors.
+ */
+bool copy_wav_clip(const std::filesystem::path& src, const WavLayout& layout, uint64_t begin, uint64_t end,
+                   const std::filesystem::path& dst);
+
+
+#endif //AUDIO_SLICER_WAVCOPY_H